@@ -0,0 +1,11 @@
+//帧内存池：聊天帧、帧批次和自适应读缓冲区的存储，稳定运行后收发消息不再向堆申请内存
+#ifndef FRAME_POOL_HPP
+#define FRAME_POOL_HPP
+
+#include "size_class_pool.hpp"
+//--------------------------------
+//块大小从64字节到32MB共20级，每级最多缓存4MB
+typedef basic_size_class_pool<6, 20, 4 * 1024 * 1024> frame_pool;
+typedef pool_stats frame_pool_stats;
+
+#endif // FRAME_POOL_HPP
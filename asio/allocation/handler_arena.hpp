@@ -0,0 +1,186 @@
+//每个连接的处理函数内存：多个不同大小的槽位，读、写、定时器同时挂起时也不必向堆申请
+#ifndef HANDLER_ARENA_HPP
+#define HANDLER_ARENA_HPP
+
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+//-----------------------------------------------------------------
+//内存管理：4个256字节的小槽位 + 2个1024字节的大槽位，用位图记录占用情况
+class handler_arena
+{
+public:
+  enum { small_size = 256, small_count = 4 };
+  enum { large_size = 1024, large_count = 2 };
+
+  handler_arena()
+    : small_used_(0),
+      large_used_(0),
+      allocations_(0),
+      fallbacks_(0)
+  {
+  }
+
+  handler_arena(const handler_arena&) = delete;   // delete作用：禁止使用该函数
+  handler_arena& operator=(const handler_arena&) = delete;
+
+  void* allocate(std::size_t size)
+  {
+    ++allocations_;
+    if (size <= small_size)
+    {
+      if (void* p = take(small_, small_used_, small_count))
+        return p;
+    }
+    if (size <= large_size)
+    {
+      if (void* p = take(large_, large_used_, large_count))
+        return p;
+    }
+    ++fallbacks_;
+    return ::operator new(size);   //槽位不够或太大，回退到堆
+  }
+
+  void deallocate(void* pointer)
+  {
+    if (!give_back(small_, small_used_, small_count, pointer)
+        && !give_back(large_, large_used_, large_count, pointer))
+    {
+      ::operator delete(pointer);
+    }
+  }
+
+  std::size_t allocations() const  //分配次数
+  {
+    return allocations_;
+  }
+
+  std::size_t fallbacks() const  //其中回退到堆的次数
+  {
+    return fallbacks_;
+  }
+
+  void clear_counters()  //对象复用时计数清零
+  {
+    allocations_ = 0;
+    fallbacks_ = 0;
+  }
+
+private:
+  template <typename Slot>
+  static void* take(Slot* slots, unsigned& used, unsigned count)
+  {
+    for (unsigned i = 0; i < count; ++i)
+    {
+      if (!(used & (1u << i)))
+      {
+        used |= 1u << i;
+        return &slots[i];
+      }
+    }
+    return nullptr;
+  }
+
+  template <typename Slot>
+  static bool give_back(Slot* slots, unsigned& used, unsigned count, void* pointer)
+  {
+    Slot* p = static_cast<Slot*>(pointer);
+    if (p < slots || p >= slots + count)
+      return false;
+    used &= ~(1u << (p - slots));
+    return true;
+  }
+
+  typedef typename std::aligned_storage<small_size>::type small_slot;
+  typedef typename std::aligned_storage<large_size>::type large_slot;
+
+  small_slot small_[small_count];
+  large_slot large_[large_count];
+  unsigned small_used_;   //位图
+  unsigned large_used_;
+  std::size_t allocations_;
+  std::size_t fallbacks_;
+};
+//----------------------------------------------------------
+//分配器
+template <typename T>
+class handler_allocator
+{
+public:
+  using value_type = T;
+
+  explicit handler_allocator(handler_arena& mem)
+    : memory_(mem)
+  {
+  }
+
+  template <typename U>
+  handler_allocator(const handler_allocator<U>& other) noexcept   //noexcept：禁止抛出异常
+    : memory_(other.memory_)
+  {
+  }
+
+  bool operator==(const handler_allocator& other) const noexcept
+  {
+    return &memory_ == &other.memory_;
+  }
+
+  bool operator!=(const handler_allocator& other) const noexcept
+  {
+    return &memory_ != &other.memory_;
+  }
+
+  T* allocate(std::size_t n) const
+  {
+    return static_cast<T*>(memory_.allocate(sizeof(T) * n));
+  }
+
+  void deallocate(T* p, std::size_t /*n*/) const
+  {
+    return memory_.deallocate(p);
+  }
+
+private:
+  template <typename> friend class handler_allocator;
+  handler_arena& memory_;
+};
+//---------------------------------------------------------------
+//注册：内存分配器+处理函数
+template <typename Handler>
+class custom_alloc_handler
+{
+public:
+  using allocator_type = handler_allocator<Handler>;
+
+  custom_alloc_handler(handler_arena& m, Handler h)
+    : memory_(m),
+      handler_(h)
+  {
+  }
+
+  allocator_type get_allocator() const noexcept
+  {
+    return allocator_type(memory_);
+  }
+
+  template <typename ...Args>  //可变参数
+  void operator()(Args&&... args)
+  {
+    handler_(std::forward<Args>(args)...);
+  }
+
+private:
+  handler_arena& memory_;
+  Handler handler_;
+};
+//-------------------------------------------------------------
+//一个模板函数，返回 内存+处理函数
+template <typename Handler>
+inline custom_alloc_handler<Handler> make_custom_alloc_handler(
+    handler_arena& m, Handler h)
+{
+  return custom_alloc_handler<Handler>(m, h);
+}
+
+#endif // HANDLER_ARENA_HPP
@@ -1,227 +1,69 @@
 //tcp异步服务器
 //自定义内存分配器
-#include <array>
+#include <csignal>
 #include <cstdlib>
+#include <cstring>
 #include <iostream>
-#include <memory>
-#include <type_traits>
-#include <utility>
+#include <list>
+#include <vector>
 #include <boost/asio.hpp>
+#include "server.hpp"
 
-using boost::asio::ip::tcp;
-//-----------------------------------------------------------------
-//内存管理
-class handler_memory
+//--------------------------------------
+//主函数
+int main(int argc, char* argv[])
 {
-public:
-  handler_memory()
-    : in_use_(false)
-  {
-  }
-
-  handler_memory(const handler_memory&) = delete;   // delete作用：禁止使用该函数
-  handler_memory& operator=(const handler_memory&) = delete;
-
-  void* allocate(std::size_t size)
-  {
-    if (!in_use_ && size < sizeof(storage_))
-    {
-      in_use_ = true;
-      return &storage_;
-    }
-    else
-    {
-      return ::operator new(size);   // 定制自己的new
-    }
-  }
-
-  void deallocate(void* pointer)
+  try
   {
-    if (pointer == &storage_)
+    std::size_t threads = 1;
+    int arg = 1;
+    if (argc == 4 && std::strcmp(argv[1], "-t") == 0)  //线程数，0表示每个核一个
     {
-      in_use_ = false;
+      threads = std::strtoul(argv[2], nullptr, 10);
+      arg = 3;
     }
-    else
+    if (arg + 1 != argc)
     {
-      ::operator delete(pointer);   //定制自己的delete
+      std::cerr << "Usage: server [-t <threads>] <port>\n";
+      return 1;
     }
-  }
 
-private:
-  typename std::aligned_storage<1024>::type storage_;   //分配字节空间
-  bool in_use_;
-};
-//----------------------------------------------------------
-//分配器
-template <typename T>
-class handler_allocator
-{
-public:
-  using value_type = T;
+    //多线程时每个线程一个io_context并绑定CPU，各自用SO_REUSEPORT监听同一端口
+    bool per_core = threads != 1;
+    io_context_per_core contexts(threads, per_core);
+    std::list<arena_server> servers;
+    for (std::size_t i = 0; i < contexts.size(); ++i)
+      servers.emplace_back(contexts.context(i), std::atoi(argv[arg]), per_core);
 
-  explicit handler_allocator(handler_memory& mem)
-    : memory_(mem)
-  {
-  }
-
-  template <typename U>
-  handler_allocator(const handler_allocator<U>& other) noexcept   //noexcept：禁止抛出异常
-    : memory_(other.memory_)
-  {
-  }
-
-  bool operator==(const handler_allocator& other) const noexcept
-  {
-    return &memory_ == &other.memory_;
-  }
-
-  bool operator!=(const handler_allocator& other) const noexcept
-  {
-    return &memory_ != &other.memory_;
-  }
-
-  T* allocate(std::size_t n) const
-  {
-    return static_cast<T*>(memory_.allocate(sizeof(T) * n));
-  }
-
-  void deallocate(T* p, std::size_t /*n*/) const
-  {
-    return memory_.deallocate(p);
-  }
-
-private:
-  template <typename> friend class handler_allocator;
-  handler_memory& memory_;
-};
-//---------------------------------------------------------------
-//注册：内存分配器+处理函数
-template <typename Handler>
-class custom_alloc_handler
-{
-public:
-  using allocator_type = handler_allocator<Handler>;
-
-  custom_alloc_handler(handler_memory& m, Handler h)
-    : memory_(m),
-      handler_(h)
-  {
-  }
-
-  allocator_type get_allocator() const noexcept
-  {
-    return allocator_type(memory_);
-  }
-
-  template <typename ...Args>  //可变参数
-  void operator()(Args&&... args)
-  {
-    handler_(std::forward<Args>(args)...);
-  }
-
-private:
-  handler_memory& memory_;
-  Handler handler_;
-};
-//-------------------------------------------------------------
-//一个模板函数，返回 内存+处理函数 
-template <typename Handler>
-inline custom_alloc_handler<Handler> make_custom_alloc_handler(
-    handler_memory& m, Handler h)
-{
-  return custom_alloc_handler<Handler>(m, h);
-}
-//-----------------------------------------------------------
-//管理tcp连接
-class session
-  : public std::enable_shared_from_this<session>  //继承智能指针，允许向函数传递本对象为智能指针
-{
-public:
-  session(tcp::socket socket)
-    : socket_(std::move(socket))
-  {
-  }
-
-  void start()
-  {
-    do_read();
-  }
-
-private:
-  void do_read()
-  {
-    auto self(shared_from_this());   //获取本对象的智能指针
-    socket_.async_read_some(boost::asio::buffer(data_),   //异步读数据
-        make_custom_alloc_handler(handler_memory_,
-          [this, self](boost::system::error_code ec, std::size_t length)
-          {
-            if (!ec)
-            {
-              do_write(length);
-            }
-          }));
-  }
-
-  void do_write(std::size_t length)
-  {
-    auto self(shared_from_this());
-    boost::asio::async_write(socket_, boost::asio::buffer(data_, length), //异步写数据
-        make_custom_alloc_handler(handler_memory_,
-          [this, self](boost::system::error_code ec, std::size_t /*length*/)
-          {
-            if (!ec)
-            {
-              do_read();
-            }
-          }));
-  }
-  tcp::socket socket_;
-  std::array<char, 1024> data_;
-  handler_memory handler_memory_;
-};
-//-----------------------------------------------------------------
-//tcp监听服务器
-class server
-{
-public:
-  server(boost::asio::io_context& io_context, short port)
-    : acceptor_(io_context, tcp::endpoint(tcp::v4(), port))  //监听本机ip
-  {
-    do_accept();
-  }
-
-private:
-  void do_accept()
-  {
-    acceptor_.async_accept(              //异步接收客户端连接
-        [this](boost::system::error_code ec, tcp::socket socket)
+    boost::asio::signal_set signals(contexts.context(0), SIGINT, SIGTERM);  //退出时打印计数
+    signals.async_wait(
+        [&contexts](boost::system::error_code /*ec*/, int /*signo*/)
         {
-          if (!ec)
-          {
-            std::make_shared<session>(std::move(socket))->start();  //创建一个连接并启动
-          }
-
-          do_accept();  //继续监听客户端连接
+          contexts.stop();
         });
-  }
 
-  tcp::acceptor acceptor_;
-};
-//--------------------------------------
-//主函数
-int main(int argc, char* argv[])
-{
-  try
-  {
-    if (argc != 2)
+    contexts.run();  // 运行，开始处理任务，本函数将会阻塞，直到收到退出信号
+
+    //所有线程都已结束，汇总各个server的处理函数内存计数和连接分布
+    arena_totals totals;
+    std::size_t created = 0;
+    std::size_t reused = 0;
+    std::vector<std::size_t> accepted;
+    for (const arena_server& s: servers)
     {
-      std::cerr << "Usage: server <port>\n";
-      return 1;
+      totals.sessions += s.totals().sessions;
+      totals.allocations += s.totals().allocations;
+      totals.fallbacks += s.totals().fallbacks;
+      created += s.sessions().created();
+      reused += s.sessions().reused();
+      accepted.push_back(s.accepted());
     }
-
-    boost::asio::io_context io_context;
-    server s(io_context, std::atoi(argv[1]));
-    io_context.run();  // 运行，开始处理任务，本函数将会阻塞，如果没有待处理的任务，这个函数将会退出，接收异步通信
+    std::cout << "sessions=" << totals.sessions
+      << " handler_allocations=" << totals.allocations
+      << " heap_fallbacks=" << totals.fallbacks
+      << " sessions_created=" << created
+      << " sessions_reused=" << reused << "\n";
+    print_connection_distribution(std::cout, accepted);
   }
   catch (std::exception& e)
   {
@@ -0,0 +1,157 @@
+//tcp异步echo服务器：每个连接的处理函数内存来自自己的handler_arena
+//server.cpp和echo/echo_bench.cpp共用
+#ifndef ARENA_SERVER_HPP
+#define ARENA_SERVER_HPP
+
+#include <cstddef>
+#include <memory>
+#include <utility>
+#include <boost/asio.hpp>
+#include "handler_arena.hpp"
+#include "session_pool.hpp"
+#include "../buffers/adaptive_buffer.hpp"
+#include "../thread_pool/io_context_per_core.hpp"
+
+//-----------------------------------------------------------------
+//所有连接的处理函数内存计数
+struct arena_totals
+{
+  std::size_t sessions = 0;
+  std::size_t allocations = 0;
+  std::size_t fallbacks = 0;   //回退到堆的次数
+};
+//-----------------------------------------------------------
+//管理tcp连接
+class arena_session
+  : public std::enable_shared_from_this<arena_session>  //继承智能指针，允许向函数传递本对象为智能指针
+{
+public:
+  typedef boost::asio::ip::tcp tcp;
+
+  arena_session(tcp::socket socket, arena_totals& totals)
+    : socket_(std::move(socket)),
+      totals_(totals)
+  {
+  }
+
+  void start()
+  {
+    socket_.non_blocking(true);  //可读后用同步read_some取数据，不会阻塞
+    do_read();
+  }
+
+  void reset(tcp::socket socket)  //对象池复用：换上新连接，处理函数内存保留
+  {
+    socket_ = std::move(socket);
+  }
+
+  void recycle()  //连接结束：关闭socket、归还缓冲区，累计本次连接的计数
+  {
+    boost::system::error_code ignored;
+    socket_.close(ignored);
+    buffer_.reset();
+    ++totals_.sessions;
+    totals_.allocations += handler_memory_.allocations();
+    totals_.fallbacks += handler_memory_.fallbacks();
+    handler_memory_.clear_counters();
+  }
+
+private:
+  void do_read()  //先读一次，没有数据就归还缓冲区，等待可读
+  {
+    boost::system::error_code ec;
+    std::size_t length = socket_.read_some(buffer_.prepare(), ec);
+    if (!ec)
+    {
+      buffer_.commit(length);
+      do_write(length);
+      return;
+    }
+    buffer_.release();   //空闲连接不占用读缓冲区
+    if (ec != boost::asio::error::would_block)
+      return;
+
+    auto self(shared_from_this());   //获取本对象的智能指针
+    socket_.async_wait(tcp::socket::wait_read,   //异步等待可读
+        make_custom_alloc_handler(handler_memory_,
+          [this, self](boost::system::error_code ec)
+          {
+            if (!ec)
+            {
+              do_read();
+            }
+          }));
+  }
+
+  void do_write(std::size_t length)
+  {
+    auto self(shared_from_this());
+    boost::asio::async_write(socket_, boost::asio::buffer(buffer_.data(), length), //异步写数据
+        make_custom_alloc_handler(handler_memory_,
+          [this, self](boost::system::error_code ec, std::size_t /*length*/)
+          {
+            if (!ec)
+            {
+              do_read();
+            }
+          }));
+  }
+  tcp::socket socket_;
+  adaptive_read_buffer buffer_;  //按读到的字节数伸缩，只在读到数据到写完之间持有
+  handler_arena handler_memory_;
+  arena_totals& totals_;
+};
+//-----------------------------------------------------------------
+//tcp监听服务器
+class arena_server
+{
+public:
+  typedef boost::asio::ip::tcp tcp;
+
+  //reuse为true时各线程的server监听同一端口，由内核分配连接
+  arena_server(boost::asio::io_context& io_context, short port, bool reuse = false)
+    : acceptor_(io_context),
+      accepted_(0)
+  {
+    open_acceptor(acceptor_, tcp::endpoint(tcp::v4(), port), reuse);  //监听本机ip
+    do_accept();
+  }
+
+  std::size_t accepted() const  //接受的连接数
+  {
+    return accepted_;
+  }
+
+  const arena_totals& totals() const  //已关闭连接的计数
+  {
+    return totals_;
+  }
+
+  const session_pool<arena_session>& sessions() const
+  {
+    return sessions_;
+  }
+
+private:
+  void do_accept()
+  {
+    acceptor_.async_accept(              //异步接收客户端连接
+        [this](boost::system::error_code ec, tcp::socket socket)
+        {
+          if (!ec)
+          {
+            ++accepted_;
+            sessions_.acquire(std::move(socket), totals_)->start();  //从对象池取一个连接并启动
+          }
+
+          do_accept();  //继续监听客户端连接
+        });
+  }
+
+  tcp::acceptor acceptor_;
+  std::size_t accepted_;
+  arena_totals totals_;
+  session_pool<arena_session> sessions_;
+};
+
+#endif // ARENA_SERVER_HPP
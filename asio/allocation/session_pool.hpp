@@ -0,0 +1,108 @@
+//会话对象池：连接关闭后整个会话对象(socket、缓冲区、处理函数内存)留着给下一个连接用
+//只能在一个线程里使用；多线程服务器每个线程一个池
+#ifndef SESSION_POOL_HPP
+#define SESSION_POOL_HPP
+
+#include <cstddef>
+#include <memory>
+#include <utility>
+#include <vector>
+#include "thread_cache.hpp"
+//--------------------------------
+//Session需要提供：
+//  Session(Socket&&, Args...)   新建
+//  void reset(Socket&&)         复用时换上新连接
+//  void recycle()               最后一个引用释放时调用，关闭socket、清理状态
+template <typename Session>
+class session_pool
+{
+public:
+  enum { default_max_idle = 256 };
+
+  explicit session_pool(std::size_t max_idle = default_max_idle)
+    : state_(std::make_shared<state>(max_idle))
+  {
+  }
+
+  session_pool(const session_pool&) = delete;
+  session_pool& operator=(const session_pool&) = delete;
+
+  //有空闲会话就复用，否则新建。控制块从线程缓存分配，复用时不访问堆
+  template <typename Socket, typename ...Args>
+  std::shared_ptr<Session> acquire(Socket&& socket, Args&&... args)
+  {
+    Session* s;
+    if (state_->idle.empty())
+    {
+      s = new Session(std::forward<Socket>(socket), std::forward<Args>(args)...);
+      ++state_->created;
+    }
+    else
+    {
+      s = state_->idle.back().release();
+      state_->idle.pop_back();
+      s->reset(std::forward<Socket>(socket));
+      ++state_->reused;
+    }
+    return std::shared_ptr<Session>(s, recycler{state_},
+        thread_cache_allocator<Session>());
+  }
+
+  std::size_t idle() const  //空闲会话数
+  {
+    return state_->idle.size();
+  }
+
+  std::size_t created() const  //新建次数
+  {
+    return state_->created;
+  }
+
+  std::size_t reused() const  //复用次数
+  {
+    return state_->reused;
+  }
+
+private:
+  struct state
+  {
+    explicit state(std::size_t n)
+      : max_idle(n),
+        created(0),
+        reused(0)
+    {
+      idle.reserve(n);
+    }
+
+    std::vector<std::unique_ptr<Session> > idle;
+    std::size_t max_idle;
+    std::size_t created;
+    std::size_t reused;
+  };
+
+  //shared_ptr的删除器：会话放回池里，空闲数已满则直接删除
+  //池已销毁(服务器先于io_context析构)时不再调用recycle，服务器的成员可能已经不在了
+  struct recycler
+  {
+    std::weak_ptr<state> pool;
+
+    void operator()(Session* s) const
+    {
+      std::shared_ptr<state> p = pool.lock();
+      if (!p)
+      {
+        delete s;
+        return;
+      }
+      s->recycle();
+      if (p->idle.size() < p->max_idle)
+        p->idle.emplace_back(s);
+      else
+        delete s;
+    }
+  };
+
+  std::shared_ptr<state> state_;
+};
+
+#endif // SESSION_POOL_HPP
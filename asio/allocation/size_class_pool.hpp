@@ -0,0 +1,222 @@
+//按大小分级的线程本地内存池：每个线程一个池，稳定运行后分配/释放不再向堆申请内存
+//frame_pool(帧和读缓冲区)和thread_cache(处理函数)是它的两个实例，各自缓存、各自计数
+#ifndef SIZE_CLASS_POOL_HPP
+#define SIZE_CLASS_POOL_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <new>
+#include <vector>
+//--------------------------------
+//内存块头部，32字节，数据紧跟其后并按16字节对齐。引用计数由使用者(shared_frame、frame_batch)维护
+struct alignas(16) pool_block
+{
+  std::atomic<std::uint32_t> refs;
+  std::uint32_t size_class;
+  void* owner;          //分配它的线程的池
+  pool_block* next;     //空闲链表
+
+  char* data()
+  {
+    return reinterpret_cast<char*>(this + 1);
+  }
+
+  static pool_block* from_data(void* p)
+  {
+    return static_cast<pool_block*>(p) - 1;
+  }
+};
+//--------------------------------
+//计数器
+struct pool_stats
+{
+  std::uint64_t allocations = 0;      //allocate调用次数
+  std::uint64_t heap_allocations = 0; //其中真正向堆申请的次数
+  std::uint64_t remote_frees = 0;     //由其他线程归还的块数
+};
+//--------------------------------
+//块大小为2的幂(含头部)，从2^MinShift字节起共ClassCount级，更大的块直接new/delete
+//每级最多缓存MaxCachedBytes字节(至少一块)
+//本线程释放的块放回本地链表；其他线程释放的块挂到所属池的无锁远程链表，
+//所属线程在本地链表为空时一次性取回，因此生产者/消费者在不同线程时内存也能回到原处
+template <unsigned MinShift, unsigned ClassCount, std::size_t MaxCachedBytes>
+class basic_size_class_pool
+{
+public:
+  enum { min_shift = MinShift };
+  enum { class_count = ClassCount };
+  enum : std::size_t { max_cached_bytes = MaxCachedBytes };
+
+  basic_size_class_pool(const basic_size_class_pool&) = delete;
+  basic_size_class_pool& operator=(const basic_size_class_pool&) = delete;
+
+  //从当前线程的池中取一块至少能容纳n字节数据的内存，refs初始为1
+  static pool_block* allocate(std::size_t n)
+  {
+    return local().do_allocate(n);
+  }
+
+  //不再使用的块交还给池
+  static void recycle(pool_block* b)
+  {
+    basic_size_class_pool* owner = static_cast<basic_size_class_pool*>(b->owner);
+    if (b->size_class >= class_count)
+      destroy(b);
+    else if (owner == &local())
+      owner->push_local(b);
+    else
+      owner->push_remote(b);
+  }
+
+  static pool_stats total_stats()  //汇总所有线程的计数
+  {
+    pool_stats total;
+    std::lock_guard<std::mutex> lock(registry_mutex());
+    for (basic_size_class_pool* p: registry())
+    {
+      total.allocations += p->allocations_.load(std::memory_order_relaxed);
+      total.heap_allocations += p->heap_allocations_.load(std::memory_order_relaxed);
+      total.remote_frees += p->remote_frees_.load(std::memory_order_relaxed);
+    }
+    return total;
+  }
+
+private:
+  static_assert(sizeof(pool_block) % 16 == 0, "pool_block keeps data 16-byte aligned");
+  static_assert((std::size_t(1) << MinShift) > sizeof(pool_block), "smallest class holds no data");
+
+  basic_size_class_pool()
+    : remote_(nullptr),
+      allocations_(0),
+      heap_allocations_(0),
+      remote_frees_(0)
+  {
+    for (unsigned i = 0; i < ClassCount; ++i)
+    {
+      free_[i] = nullptr;
+      cached_[i] = 0;
+    }
+  }
+
+  //池在线程退出时不销毁：其他线程可能仍持有并归还本池分配的块
+  static basic_size_class_pool& local()
+  {
+    static thread_local basic_size_class_pool* pool = create();
+    return *pool;
+  }
+
+  static basic_size_class_pool* create()
+  {
+    basic_size_class_pool* p = new basic_size_class_pool;
+    std::lock_guard<std::mutex> lock(registry_mutex());
+    registry().push_back(p);
+    return p;
+  }
+
+  static std::vector<basic_size_class_pool*>& registry()
+  {
+    static std::vector<basic_size_class_pool*> pools;
+    return pools;
+  }
+
+  static std::mutex& registry_mutex()
+  {
+    static std::mutex m;
+    return m;
+  }
+
+  static std::size_t class_bytes(std::uint32_t c)
+  {
+    return std::size_t(1) << (MinShift + c);
+  }
+
+  static void destroy(pool_block* b)
+  {
+    b->~pool_block();
+    ::operator delete(b);
+  }
+
+  //只有本线程写计数器，不需要原子加
+  static void increment(std::atomic<std::uint64_t>& counter)
+  {
+    counter.store(counter.load(std::memory_order_relaxed) + 1,
+        std::memory_order_relaxed);
+  }
+
+  pool_block* do_allocate(std::size_t n)
+  {
+    increment(allocations_);
+
+    std::size_t bytes = n + sizeof(pool_block);
+    std::uint32_t c = 0;
+    while (c < ClassCount && class_bytes(c) < bytes)
+      ++c;
+
+    if (c < ClassCount)
+    {
+      if (!free_[c])
+        drain_remote();
+      if (pool_block* b = free_[c])
+      {
+        free_[c] = b->next;
+        --cached_[c];
+        b->refs.store(1, std::memory_order_relaxed);
+        return b;
+      }
+      bytes = class_bytes(c);
+    }
+
+    increment(heap_allocations_);
+    pool_block* b = new (::operator new(bytes)) pool_block;
+    b->refs.store(1, std::memory_order_relaxed);
+    b->size_class = c;
+    b->owner = this;
+    b->next = nullptr;
+    return b;
+  }
+
+  void push_local(pool_block* b)
+  {
+    std::uint32_t c = b->size_class;
+    if ((cached_[c] + 1) * class_bytes(c) > MaxCachedBytes && cached_[c] != 0)
+    {
+      destroy(b);  //缓存已满
+      return;
+    }
+    b->next = free_[c];
+    free_[c] = b;
+    ++cached_[c];
+  }
+
+  void push_remote(pool_block* b)  //其他线程调用
+  {
+    b->next = remote_.load(std::memory_order_relaxed);
+    while (!remote_.compare_exchange_weak(b->next, b,
+          std::memory_order_release, std::memory_order_relaxed))
+    {
+    }
+  }
+
+  void drain_remote()  //整条链表一次取走，没有ABA问题
+  {
+    pool_block* b = remote_.exchange(nullptr, std::memory_order_acquire);
+    while (b)
+    {
+      pool_block* next = b->next;
+      increment(remote_frees_);
+      push_local(b);
+      b = next;
+    }
+  }
+
+  pool_block* free_[ClassCount];
+  std::size_t cached_[ClassCount];
+  std::atomic<pool_block*> remote_;
+  std::atomic<std::uint64_t> allocations_;
+  std::atomic<std::uint64_t> heap_allocations_;
+  std::atomic<std::uint64_t> remote_frees_;
+};
+
+#endif // SIZE_CLASS_POOL_HPP
@@ -0,0 +1,223 @@
+//线程本地的处理函数内存缓存：按大小分级回收，所有处理函数共用，不需要每个连接各带一块内存
+//在别的线程释放的内存会归还到分配它的线程的缓存
+#ifndef THREAD_CACHE_HPP
+#define THREAD_CACHE_HPP
+
+#include <cstddef>
+#include <type_traits>
+#include <utility>
+#include <boost/asio/associated_executor.hpp>
+#include <boost/asio/detail/handler_cont_helpers.hpp>
+#include <boost/asio/post.hpp>
+#include "size_class_pool.hpp"
+//--------------------------------
+typedef pool_stats thread_cache_stats;  //计数器
+//--------------------------------
+//块大小从64字节到8KB共8级，每级最多缓存1MB，更大的直接new/delete
+class thread_cache
+{
+public:
+  typedef basic_size_class_pool<6, 8, 1024 * 1024> pool;
+
+  static void* allocate(std::size_t n)
+  {
+    return pool::allocate(n)->data();
+  }
+
+  static void deallocate(void* p)
+  {
+    pool::recycle(pool_block::from_data(p));
+  }
+
+  static thread_cache_stats total_stats()  //汇总所有线程的计数
+  {
+    return pool::total_stats();
+  }
+};
+//----------------------------------------------------------
+//分配器，无状态，所有实例相等
+template <typename T>
+class thread_cache_allocator
+{
+public:
+  using value_type = T;
+
+  thread_cache_allocator() noexcept
+  {
+  }
+
+  template <typename U>
+  thread_cache_allocator(const thread_cache_allocator<U>&) noexcept
+  {
+  }
+
+  bool operator==(const thread_cache_allocator&) const noexcept
+  {
+    return true;
+  }
+
+  bool operator!=(const thread_cache_allocator&) const noexcept
+  {
+    return false;
+  }
+
+  T* allocate(std::size_t n) const
+  {
+    return static_cast<T*>(thread_cache::allocate(sizeof(T) * n));
+  }
+
+  void deallocate(T* p, std::size_t /*n*/) const
+  {
+    thread_cache::deallocate(p);
+  }
+};
+//---------------------------------------------------------------
+//注册：线程缓存分配器+处理函数，处理函数原有的执行器保持不变
+template <typename Handler>
+class thread_cached_handler
+{
+public:
+  using allocator_type = thread_cache_allocator<void>;
+
+  explicit thread_cached_handler(Handler h)
+    : handler_(std::move(h))
+  {
+  }
+
+  allocator_type get_allocator() const noexcept
+  {
+    return allocator_type();
+  }
+
+  template <typename ...Args>
+  void operator()(Args&&... args)
+  {
+    handler_(std::forward<Args>(args)...);
+  }
+
+  const Handler& handler() const
+  {
+    return handler_;
+  }
+
+  Handler& handler()
+  {
+    return handler_;
+  }
+
+private:
+  Handler handler_;
+};
+//组合操作(如async_write)的后续步骤是continuation，调度器据此把它留在当前线程的队列里
+template <typename Handler>
+inline bool asio_handler_is_continuation(thread_cached_handler<Handler>* this_handler)
+{
+  return boost_asio_handler_cont_helpers::is_continuation(this_handler->handler());
+}
+//-------------------------------------------------------------
+//单独包装一个处理函数：socket.async_read_some(buf, thread_cached([...](...) { ... }));
+template <typename Handler>
+inline thread_cached_handler<typename std::decay<Handler>::type>
+thread_cached(Handler&& h)
+{
+  return thread_cached_handler<typename std::decay<Handler>::type>(
+      std::forward<Handler>(h));
+}
+
+//投递到其他线程的处理函数同样使用线程缓存
+template <typename ExecutionContext, typename Handler>
+inline void post_thread_cached(ExecutionContext& context, Handler&& h)
+{
+  boost::asio::post(context, thread_cached(std::forward<Handler>(h)));
+}
+//-------------------------------------------------------------
+//I/O对象适配器：所有async_*操作的处理函数自动使用线程缓存，调用处照常传lambda
+//async_write/async_read等组合操作调用的是这里的async_write_some/async_read_some，
+//中间步骤同样使用线程缓存
+//用法：thread_cached_io<tcp::socket> socket_; thread_cached_io<tcp::acceptor> acceptor_;
+template <typename IoObject>
+class thread_cached_io
+  : public IoObject
+{
+public:
+  using IoObject::IoObject;
+
+  thread_cached_io(IoObject&& other)  //接管已连接的socket
+    : IoObject(std::move(other))
+  {
+  }
+
+  thread_cached_io& operator=(IoObject&& other)
+  {
+    IoObject::operator=(std::move(other));
+    return *this;
+  }
+
+  template <typename Buffers, typename Handler>
+  auto async_read_some(const Buffers& buffers, Handler&& handler)
+  {
+    return IoObject::async_read_some(buffers, thread_cached(std::forward<Handler>(handler)));
+  }
+
+  template <typename Buffers, typename Handler>
+  auto async_write_some(const Buffers& buffers, Handler&& handler)
+  {
+    return IoObject::async_write_some(buffers, thread_cached(std::forward<Handler>(handler)));
+  }
+
+  template <typename Buffers, typename Handler>
+  auto async_receive(const Buffers& buffers, Handler&& handler)
+  {
+    return IoObject::async_receive(buffers, thread_cached(std::forward<Handler>(handler)));
+  }
+
+  template <typename Buffers, typename Handler>
+  auto async_send(const Buffers& buffers, Handler&& handler)
+  {
+    return IoObject::async_send(buffers, thread_cached(std::forward<Handler>(handler)));
+  }
+
+  template <typename WaitType, typename Handler>
+  auto async_wait(WaitType w, Handler&& handler)
+  {
+    return IoObject::async_wait(w, thread_cached(std::forward<Handler>(handler)));
+  }
+
+  template <typename HandshakeType, typename Handler>
+  auto async_handshake(HandshakeType type, Handler&& handler)  //ssl::stream
+  {
+    return IoObject::async_handshake(type, thread_cached(std::forward<Handler>(handler)));
+  }
+
+  template <typename Handler>
+  auto async_accept(Handler&& handler)  //acceptor：处理函数收到新的socket
+  {
+    return IoObject::async_accept(thread_cached(std::forward<Handler>(handler)));
+  }
+
+  template <typename Target, typename Handler>
+  auto async_accept(Target& target, Handler&& handler)  //target是io_context或接收连接的socket
+  {
+    return IoObject::async_accept(target, thread_cached(std::forward<Handler>(handler)));
+  }
+};
+
+namespace boost {
+namespace asio {
+
+template <typename Handler, typename Executor>
+struct associated_executor<thread_cached_handler<Handler>, Executor>
+{
+  typedef typename associated_executor<Handler, Executor>::type type;
+
+  static type get(const thread_cached_handler<Handler>& h,
+      const Executor& ex = Executor()) noexcept
+  {
+    return associated_executor<Handler, Executor>::get(h.handler(), ex);
+  }
+};
+
+} // namespace asio
+} // namespace boost
+
+#endif // THREAD_CACHE_HPP
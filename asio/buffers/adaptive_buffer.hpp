@@ -0,0 +1,109 @@
+//自适应读缓冲区：按最近几次读到的字节数放大或缩小，内存取自按大小分级的全局内存池
+//连接空闲等待可读时把缓冲区还给内存池，大量空闲连接不占用读缓冲区
+#ifndef ADAPTIVE_BUFFER_HPP
+#define ADAPTIVE_BUFFER_HPP
+
+#include <cstddef>
+#include <boost/asio/buffer.hpp>
+#include "../allocation/frame_pool.hpp"
+//--------------------------------
+//用法：等待可读 -> read_some(prepare()) -> commit(n) -> 处理数据 -> release() -> 再等待可读
+//读满整个缓冲区时下一次加倍；连续shrink_after次只用到四分之一以下时减半
+class adaptive_read_buffer
+{
+public:
+  enum : std::size_t { default_min_size = 512, default_max_size = 64 * 1024 };
+  enum { shrink_after = 4 };
+
+  explicit adaptive_read_buffer(std::size_t min_size = default_min_size,
+      std::size_t max_size = default_max_size)
+    : block_(nullptr),
+      capacity_(0),
+      min_size_(min_size),
+      max_size_(max_size > min_size ? max_size : min_size),   //两者都应是2的幂
+      size_(min_size),
+      small_reads_(0)
+  {
+  }
+
+  adaptive_read_buffer(const adaptive_read_buffer&) = delete;
+  adaptive_read_buffer& operator=(const adaptive_read_buffer&) = delete;
+
+  ~adaptive_read_buffer()
+  {
+    release();
+  }
+
+  //取当前大小的缓冲区，没有则从内存池分配
+  //size_是含块头部的大小(2的幂)，正好用满内存池的一级
+  boost::asio::mutable_buffer prepare()
+  {
+    std::size_t capacity = size_ - sizeof(pool_block);
+    if (block_ && capacity_ != capacity)
+      release();  //大小已调整
+    if (!block_)
+    {
+      block_ = frame_pool::allocate(capacity);
+      capacity_ = capacity;
+    }
+    return boost::asio::buffer(block_->data(), capacity_);
+  }
+
+  void commit(std::size_t n)  //读到了n个字节，据此调整下一次的大小
+  {
+    if (n == capacity_ && size_ < max_size_)
+    {
+      size_ = size_ * 2 < max_size_ ? size_ * 2 : max_size_;
+      small_reads_ = 0;
+    }
+    else if (n <= capacity_ / 4 && size_ > min_size_)
+    {
+      if (++small_reads_ >= shrink_after)
+      {
+        size_ = size_ / 2 > min_size_ ? size_ / 2 : min_size_;
+        small_reads_ = 0;
+      }
+    }
+    else
+    {
+      small_reads_ = 0;
+    }
+  }
+
+  const char* data() const
+  {
+    return block_->data();
+  }
+
+  void release()  //数据已处理完，缓冲区还给内存池
+  {
+    if (block_)
+    {
+      frame_pool::recycle(block_);
+      block_ = nullptr;
+      capacity_ = 0;
+    }
+  }
+
+  std::size_t size() const  //下一次prepare的大小
+  {
+    return size_;
+  }
+
+  void reset()  //连接对象复用：恢复初始大小
+  {
+    release();
+    size_ = min_size_;
+    small_reads_ = 0;
+  }
+
+private:
+  pool_block* block_;
+  std::size_t capacity_;
+  std::size_t min_size_;
+  std::size_t max_size_;
+  std::size_t size_;
+  unsigned small_reads_;
+};
+
+#endif // ADAPTIVE_BUFFER_HPP
@@ -0,0 +1,85 @@
+//字节环形缓冲区：读操作往尾部写入，写操作从头部取出，两者可以同时挂起
+#ifndef BYTE_RING_HPP
+#define BYTE_RING_HPP
+
+#include <array>
+#include <cstddef>
+#include <vector>
+#include <boost/asio/buffer.hpp>
+//--------------------------------
+//prepare()/data()绕回时返回两段，一次系统调用读写完
+class byte_ring
+{
+public:
+  explicit byte_ring(std::size_t capacity)
+    : buffer_(capacity),
+      head_(0),
+      size_(0)
+  {
+  }
+
+  byte_ring(const byte_ring&) = delete;
+  byte_ring& operator=(const byte_ring&) = delete;
+
+  bool empty() const
+  {
+    return size_ == 0;
+  }
+
+  bool full() const
+  {
+    return size_ == buffer_.size();
+  }
+
+  std::size_t size() const
+  {
+    return size_;
+  }
+
+  typedef std::array<boost::asio::mutable_buffer, 2> mutable_buffers_type;
+  typedef std::array<boost::asio::const_buffer, 2> const_buffers_type;
+
+  //尾部的空闲空间，给async_read_some
+  mutable_buffers_type prepare()
+  {
+    std::size_t tail = (head_ + size_) % buffer_.size();
+    std::size_t free = buffer_.size() - size_;
+    std::size_t first = buffer_.size() - tail < free ? buffer_.size() - tail : free;
+    return mutable_buffers_type{{
+      boost::asio::buffer(buffer_.data() + tail, first),
+      boost::asio::buffer(buffer_.data(), free - first)}};
+  }
+
+  void commit(std::size_t n)  //读到了n个字节
+  {
+    size_ += n;
+  }
+
+  //头部的未写出数据，给async_write_some
+  const_buffers_type data() const
+  {
+    std::size_t first = buffer_.size() - head_ < size_ ? buffer_.size() - head_ : size_;
+    return const_buffers_type{{
+      boost::asio::buffer(buffer_.data() + head_, first),
+      boost::asio::buffer(buffer_.data(), size_ - first)}};
+  }
+
+  void consume(std::size_t n)  //写出了n个字节
+  {
+    size_ -= n;
+    head_ = (head_ + n) % buffer_.size();  //读可能正挂起在尾部，清空时也不能移回开头
+  }
+
+  void clear()
+  {
+    head_ = 0;
+    size_ = 0;
+  }
+
+private:
+  std::vector<char> buffer_;
+  std::size_t head_;   //第一个未写出的字节
+  std::size_t size_;   //未写出的字节数
+};
+
+#endif // BYTE_RING_HPP
@@ -5,6 +5,7 @@
 #include <utility>
 #include <vector>
 #include <ctime>
+#include "../allocation/session_pool.hpp"
 
 using boost::asio::ip::tcp;
 //----------------------------------------------------
@@ -44,6 +45,17 @@ public:
     do_write();
   }
 
+  void reset(tcp::socket socket)  //对象池复用：换上新连接
+  {
+    socket_ = std::move(socket);
+  }
+
+  void recycle()  //发送完成，放回对象池之前关闭socket
+  {
+    boost::system::error_code ignored;
+    socket_.close(ignored);
+  }
+
 private:
   void do_write()
   {
@@ -81,7 +93,7 @@ private:
         {
           if (!ec)
           {
-            std::make_shared<session>(std::move(socket))->start();
+            sessions_.acquire(std::move(socket))->start();  //从对象池取连接对象
           }
 
           do_accept();
@@ -89,6 +101,7 @@ private:
   }
 
   tcp::acceptor acceptor_;
+  session_pool<session> sessions_;
 };
 //---------------------------------------
 //主函数
@@ -0,0 +1,187 @@
+//聊天服务器广播吞吐量测试
+//先启动服务器：chat_server [-w <max_write_bytes>] <port>
+//-w 1 相当于每次只写一帧(关闭聚合写)，与默认值对比即可看出聚合写的效果
+//默认发送队列不限制；用-q/-b设置的上限小于消息数时服务器会丢帧或断开，completed会小于clients
+//速率按实际收到的帧数和最后一帧到达的时间计算；有客户端没收齐时报告缺的帧数并返回1
+//-t <threads> 对比多线程分片的扩展性
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <vector>
+#include <boost/asio.hpp>
+#include "chat_frame.hpp"
+#include "frame_reader.hpp"
+
+using boost::asio::ip::tcp;
+
+//----------------------------------------------------------------------
+//所有测试客户端共用的计数
+struct bench_progress
+{
+  std::size_t finished = 0;   //收齐全部消息的客户端数
+  std::size_t received = 0;   //收到的带标记的帧数
+  std::chrono::steady_clock::time_point last;  //最后收到一帧的时间
+};
+
+//----------------------------------------------------------------------
+//测试客户端，只统计带本次测试标记的帧(排除房间历史消息)
+class bench_client
+{
+public:
+  bench_client(boost::asio::io_context& io_context, std::size_t body_size,
+      std::uint64_t nonce, std::size_t expected, bench_progress& progress)
+    : socket_(io_context),
+      reader_(body_size),
+      nonce_(nonce),
+      expected_(expected),
+      received_(0),
+      progress_(progress)
+  {
+  }
+
+  tcp::socket& socket()
+  {
+    return socket_;
+  }
+
+  void start()
+  {
+    do_read();
+  }
+
+private:
+  void do_read()
+  {
+    socket_.async_read_some(reader_.prepare(),
+        [this](boost::system::error_code ec, std::size_t length)
+        {
+          if (ec)
+            return;
+
+          reader_.commit(length);
+          frame_view f;
+          while (reader_.next(f))
+          {
+            if (f.body_length >= sizeof(nonce_)
+                && std::memcmp(f.body(), &nonce_, sizeof(nonce_)) == 0)
+            {
+              ++progress_.received;
+              progress_.last = std::chrono::steady_clock::now();
+              if (++received_ == expected_)
+                ++progress_.finished;
+            }
+          }
+          if (!reader_.bad())
+            do_read();
+        });
+  }
+
+  tcp::socket socket_;
+  frame_reader reader_;
+  std::uint64_t nonce_;
+  std::size_t expected_;
+  std::size_t received_;
+  bench_progress& progress_;
+};
+
+//----------------------------------------------------------------------
+
+int main(int argc, char* argv[])
+{
+  try
+  {
+    if (argc != 6)
+    {
+      std::cerr << "Usage: chat_bench <host> <port> <clients> <messages> <body_size>\n";
+      return 1;
+    }
+
+    std::size_t clients = std::strtoul(argv[3], nullptr, 10);
+    std::size_t messages = std::strtoul(argv[4], nullptr, 10);
+    std::size_t body_size = std::strtoul(argv[5], nullptr, 10);
+    std::uint64_t nonce = std::chrono::steady_clock::now().time_since_epoch().count();
+    if (clients == 0 || body_size < sizeof(nonce))
+    {
+      std::cerr << "clients must be > 0 and body_size >= " << sizeof(nonce) << "\n";
+      return 1;
+    }
+
+    boost::asio::io_context io_context;
+    tcp::resolver resolver(io_context);
+    auto endpoints = resolver.resolve(argv[1], argv[2]);
+
+    bench_progress progress;
+    std::vector<std::unique_ptr<bench_client> > participants;
+    for (std::size_t i = 0; i < clients; ++i)  //同步连接，保证发送前所有人都已加入房间
+    {
+      participants.emplace_back(new bench_client(
+            io_context, body_size, nonce, messages, progress));
+      boost::asio::connect(participants.back()->socket(), endpoints);
+      participants.back()->socket().set_option(tcp::no_delay(true));
+      participants.back()->start();
+    }
+
+    //预先编码全部消息，由第一个客户端一次性发出
+    chat_frame frame(body_size);
+    frame.body_length(body_size);
+    std::memset(frame.body(), 'x', body_size);
+    std::memcpy(frame.body(), &nonce, sizeof(nonce));
+    frame.encode_header();
+    std::vector<char> payload;
+    payload.reserve(frame.length() * messages);
+    for (std::size_t i = 0; i < messages; ++i)
+      payload.insert(payload.end(), frame.data(), frame.data() + frame.length());
+
+    io_context.run_for(std::chrono::milliseconds(200));  //等待服务器处理join
+
+    auto start = std::chrono::steady_clock::now();
+    progress.last = start;
+    boost::asio::async_write(participants.front()->socket(),
+        boost::asio::buffer(payload),
+        [](boost::system::error_code ec, std::size_t /*length*/)
+        {
+          if (ec)
+            std::cerr << "send failed: " << ec.message() << "\n";
+        });
+
+    //全部收齐，或者2秒没有收到新的帧(服务器丢帧或断开了慢速连接)时结束
+    auto deadline = start + std::chrono::seconds(60);
+    auto idle_timeout = std::chrono::seconds(2);
+    while (progress.finished < clients)
+    {
+      auto now = std::chrono::steady_clock::now();
+      if (now >= deadline || now - progress.last >= idle_timeout)
+        break;
+      io_context.run_one_for(std::chrono::milliseconds(100));
+    }
+    double seconds = std::chrono::duration<double>(progress.last - start).count();
+
+    double deliveries = static_cast<double>(progress.received);
+    std::cout << "clients=" << clients
+      << " messages=" << messages
+      << " body_size=" << body_size
+      << " completed=" << progress.finished
+      << " received=" << progress.received
+      << " seconds=" << seconds
+      << " deliveries_per_sec=" << (seconds > 0 ? deliveries / seconds : 0.0)
+      << " MB_per_sec=" << (seconds > 0 ? deliveries * frame.length() / seconds / (1024 * 1024) : 0.0)
+      << "\n";
+
+    if (progress.finished < clients)
+    {
+      std::cerr << "Incomplete: " << clients - progress.finished << " of " << clients
+        << " clients missed " << messages * clients - progress.received << " frames\n";
+      return 1;
+    }
+  }
+  catch (std::exception& e)
+  {
+    std::cerr << "Exception: " << e.what() << "\n";
+    return 1;
+  }
+
+  return 0;
+}
@@ -1,34 +1,41 @@
+#include <cstdint>
 #include <cstdlib>
-#include <deque>
+#include <cstring>
 #include <iostream>
+#include <string>
 #include <thread>
 #include <boost/asio.hpp>
-#include "chat_message.hpp"
+#include "chat_frame.hpp"
+#include "frame_reader.hpp"
+#include "shared_frame.hpp"
+#include "write_queue.hpp"
 
 using boost::asio::ip::tcp;
 
-typedef std::deque<chat_message> chat_message_queue;
+typedef basic_write_queue<shared_frame> chat_message_queue; //聚合写队列，元素是内存池里的帧句柄
 //-----------------------------------------------------
 //聊天客户端
 class chat_client
 {
 public:
   chat_client(boost::asio::io_context& io_context,
-      const tcp::resolver::results_type& endpoints)
+      const tcp::resolver::results_type& endpoints, std::uint32_t topic,
+      std::size_t max_body_length)
     : io_context_(io_context),
-      socket_(io_context)
+      socket_(io_context),
+      topic_(topic),
+      reader_(max_body_length)
   {
     do_connect(endpoints);
   }
 
-  void write(const chat_message& msg)  //写消息
+  void write(shared_frame msg)  //写消息，只传递句柄不拷贝数据
   {
     boost::asio::post(io_context_,
-        [this, msg]()
+        [this, msg = std::move(msg)]()
         {
-          bool write_in_progress = !write_msgs_.empty();
-          write_msgs_.push_back(msg);
-          if (!write_in_progress)
+          write_msgs_.push(msg);
+          if (!write_msgs_.writing())
           {
             do_write();
           }
@@ -48,57 +55,61 @@ private:
         {
           if (!ec)
           {
-            do_read_header();
+            if (topic_ != 0)
+              switch_topic();
+            do_read();
           }
         });
   }
 
-  void do_read_header()  //读消息头
+  void switch_topic()  //服务器默认把连接加入0号房间，改为订阅topic_
   {
-    boost::asio::async_read(socket_,
-        boost::asio::buffer(read_msg_.data(), chat_message::header_length),
-        [this](boost::system::error_code ec, std::size_t /*length*/)
-        {
-          if (!ec && read_msg_.decode_header())
-          {
-            do_read_body();
-          }
-          else
-          {
-            socket_.close();
-          }
-        });
+    chat_frame msg;
+    msg.topic(frame_header::control_topic);
+    msg.body_length(2 * control_entry::length);
+    control_entry::encode(msg.body(), control_entry::unsubscribe, 0);
+    control_entry::encode(msg.body() + control_entry::length,
+        control_entry::subscribe, topic_);
+    msg.encode_header();
+    write_msgs_.push(shared_frame(msg));
+    if (!write_msgs_.writing())
+    {
+      do_write();
+    }
   }
 
-  void do_read_body() //读消息体
+  void do_read()  //一次读入大块数据，打印其中所有完整的帧
   {
-    boost::asio::async_read(socket_,
-        boost::asio::buffer(read_msg_.body(), read_msg_.body_length()),
-        [this](boost::system::error_code ec, std::size_t /*length*/)
+    socket_.async_read_some(reader_.prepare(),
+        [this](boost::system::error_code ec, std::size_t length)
         {
           if (!ec)
           {
-            std::cout.write(read_msg_.body(), read_msg_.body_length());
-            std::cout << "\n";
-            do_read_header();
-          }
-          else
-          {
-            socket_.close();
+            reader_.commit(length);
+            frame_view f;
+            while (reader_.next(f))
+            {
+              std::cout.write(f.body(), f.body_length);
+              std::cout << "\n";
+            }
+            if (!reader_.bad())
+            {
+              do_read();
+              return;
+            }
           }
+          socket_.close();
         });
   }
 
-  void do_write() //写消息
+  void do_write() //把排队的消息聚合成一次写
   {
-    boost::asio::async_write(socket_,
-        boost::asio::buffer(write_msgs_.front().data(),
-          write_msgs_.front().length()),
+    boost::asio::async_write(socket_, write_msgs_.prepare(),
         [this](boost::system::error_code ec, std::size_t /*length*/)
         {
           if (!ec)
           {
-            write_msgs_.pop_front();
+            write_msgs_.consume();
             if (!write_msgs_.empty())
             {
               do_write();
@@ -114,7 +125,8 @@ private:
 private:
   boost::asio::io_context& io_context_;
   tcp::socket socket_;
-  chat_message read_msg_;
+  std::uint32_t topic_;  //房间号
+  frame_reader reader_;
   chat_message_queue write_msgs_;
 };
 
@@ -122,28 +134,39 @@ int main(int argc, char* argv[])
 {
   try
   {
-    if (argc != 3)
+    std::size_t max_body_length = chat_frame::default_max_body_length;
+    int arg = 1;
+    for (; arg + 1 < argc && argv[arg][0] == '-'; arg += 2)
+    {
+      if (std::strcmp(argv[arg], "-l") == 0)  //包体最大长度，与服务器的-l一致
+        max_body_length = std::strtoul(argv[arg + 1], nullptr, 10);
+      else
+        break;
+    }
+    if (argc - arg != 2 && argc - arg != 3)
     {
-      std::cerr << "Usage: chat_client <host> <port>\n";
+      std::cerr << "Usage: chat_client [-l <max_body_length>] <host> <port> [<topic>]\n";
       return 1;
     }
+    std::uint32_t topic = argc - arg == 3 ? std::strtoul(argv[arg + 2], nullptr, 10) : 0;
 
     boost::asio::io_context io_context;
 
     tcp::resolver resolver(io_context);
-    auto endpoints = resolver.resolve(argv[1], argv[2]);
-    chat_client c(io_context, endpoints);
+    auto endpoints = resolver.resolve(argv[arg], argv[arg + 1]);
+    chat_client c(io_context, endpoints, topic, max_body_length);
 
     std::thread t([&io_context](){ io_context.run(); });
 
-    char line[chat_message::max_body_length + 1];
-    while (std::cin.getline(line, chat_message::max_body_length + 1))  //循环发送消息
+    std::string line;
+    chat_frame msg(max_body_length);  //复用同一个编码缓冲区
+    msg.topic(topic);
+    while (std::getline(std::cin, line))  //循环发送消息，超长的行截断
     {
-      chat_message msg;
-      msg.body_length(std::strlen(line));
-      std::memcpy(msg.body(), line, msg.body_length());
+      msg.body_length(line.size());
+      std::memcpy(msg.body(), line.data(), msg.body_length());
       msg.encode_header();
-      c.write(msg);
+      c.write(shared_frame(msg));
     }
 
     c.close();
@@ -0,0 +1,156 @@
+//二进制帧：包头为4字节包体长度+4字节主题(房间)号，均为网络字节序，tcp数据需要拆包
+#ifndef CHAT_FRAME_HPP
+#define CHAT_FRAME_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+//--------------------------------
+//包头编解码，移位实现，无libc调用、无分支
+struct frame_header
+{
+  enum { length = 8 };
+  enum : std::uint32_t { control_topic = 0xffffffffu };  //发往此主题的是控制帧
+
+  static void store_u32(char* p, std::uint32_t v)
+  {
+    p[0] = static_cast<char>(v >> 24);
+    p[1] = static_cast<char>(v >> 16);
+    p[2] = static_cast<char>(v >> 8);
+    p[3] = static_cast<char>(v);
+  }
+
+  static std::uint32_t load_u32(const char* p)
+  {
+    const unsigned char* u = reinterpret_cast<const unsigned char*>(p);
+    return (static_cast<std::uint32_t>(u[0]) << 24)
+      | (static_cast<std::uint32_t>(u[1]) << 16)
+      | (static_cast<std::uint32_t>(u[2]) << 8)
+      | static_cast<std::uint32_t>(u[3]);
+  }
+
+  static void encode(char* p, std::uint32_t body_length, std::uint32_t topic)
+  {
+    store_u32(p, body_length);
+    store_u32(p + 4, topic);
+  }
+
+  static std::uint32_t decode(const char* p)  //包体长度
+  {
+    return load_u32(p);
+  }
+
+  static std::uint32_t decode_topic(const char* p)
+  {
+    return load_u32(p + 4);
+  }
+};
+//--------------------------------
+//控制帧包体：若干条 1字节操作 + 4字节主题号
+struct control_entry
+{
+  enum { length = 5 };
+  enum op : unsigned char { subscribe = 1, unsubscribe = 2 };
+
+  static void encode(char* p, op o, std::uint32_t topic)
+  {
+    p[0] = static_cast<char>(o);
+    frame_header::store_u32(p + 1, topic);
+  }
+};
+//--------------------------------
+//聊天帧  包头+包体，包体最大长度可配置(上限16MB)，topic为所属房间
+class chat_frame
+{
+public:
+  enum { header_length = frame_header::length };
+  enum : std::size_t { default_max_body_length = 512 };
+  enum : std::size_t { max_body_limit = 16 * 1024 * 1024 };
+
+  explicit chat_frame(std::size_t max_body_length = default_max_body_length)
+    : data_(header_length),
+      body_length_(0),
+      topic_(0),
+      max_body_length_(max_body_length < max_body_limit
+          ? max_body_length : max_body_limit)
+  {
+  }
+
+  const char* data() const
+  {
+    return data_.data();
+  }
+
+  char* data()
+  {
+    return data_.data();
+  }
+
+  std::size_t length() const
+  {
+    return header_length + body_length_;
+  }
+
+  const char* body() const
+  {
+    return data_.data() + header_length;
+  }
+
+  char* body()
+  {
+    return data_.data() + header_length;
+  }
+
+  std::size_t body_length() const
+  {
+    return body_length_;
+  }
+
+  std::uint32_t topic() const
+  {
+    return topic_;
+  }
+
+  void topic(std::uint32_t new_topic)
+  {
+    topic_ = new_topic;
+  }
+
+  std::size_t max_body_length() const
+  {
+    return max_body_length_;
+  }
+
+  void body_length(std::size_t new_length)  //超过上限则截断
+  {
+    body_length_ = new_length < max_body_length_ ? new_length : max_body_length_;
+    data_.resize(header_length + body_length_);  //容量只增不减，稳定后不再分配
+  }
+
+  bool decode_header()  //解包头
+  {
+    std::size_t n = frame_header::decode(data_.data());
+    topic_ = frame_header::decode_topic(data_.data());
+    if (n > max_body_length_)
+    {
+      body_length_ = 0;
+      return false;
+    }
+    body_length(n);
+    return true;
+  }
+
+  void encode_header()  //封装包头
+  {
+    frame_header::encode(data_.data(),
+        static_cast<std::uint32_t>(body_length_), topic_);
+  }
+
+private:
+  std::vector<char> data_;
+  std::size_t body_length_;
+  std::uint32_t topic_;
+  std::size_t max_body_length_;
+};
+
+#endif // CHAT_FRAME_HPP
@@ -1,17 +1,45 @@
+#include <algorithm>
+#include <chrono>
+#include <csignal>
+#include <cstdint>
 #include <cstdlib>
-#include <deque>
+#include <cstring>
 #include <iostream>
 #include <list>
 #include <memory>
-#include <set>
+#include <thread>
 #include <utility>
+#include <vector>
 #include <boost/asio.hpp>
-#include "chat_message.hpp"
+#include "../allocation/frame_pool.hpp"
+#include "../allocation/session_pool.hpp"
+#include "../allocation/thread_cache.hpp"
+#include "../thread_pool/io_context_per_core.hpp"
+#include "chat_frame.hpp"
+#include "frame_reader.hpp"
+#include "history_ring.hpp"
+#include "participant_registry.hpp"
+#include "shared_frame.hpp"
+#include "write_queue.hpp"
 
 using boost::asio::ip::tcp;
 
 //----------------------------------------------------------------------
-typedef std::deque<chat_message> chat_message_queue; //消息队列
+typedef basic_history_ring<shared_frame> history_ring; //历史消息，元素共享同一份帧数据
+typedef basic_write_queue<shared_frame> write_queue; //聚合写队列
+
+//----------------------------------------------------------------------
+//服务器配置
+struct chat_options
+{
+  std::size_t max_body_length = chat_frame::default_max_body_length;  //包体最大长度
+  std::size_t max_write_bytes = write_queue::default_max_write_bytes; //一次聚合写的字节上限
+  write_queue_limits write_limits;  //每个连接的发送队列上限和慢速连接策略
+  std::size_t history_depth = 100;  //新加入者能收到的历史消息条数
+  std::size_t max_topics = 65536;   //主题号范围[0, max_topics)
+  std::size_t max_idle_sessions = 256;  //每个分片缓存的空闲会话数
+  bool reuse_port = false;  //每个分片一个SO_REUSEPORT监听socket，否则由第0个分片轮流分配连接
+};
 
 //----------------------------------------------------------------------
 //参加者
@@ -19,42 +47,278 @@ class chat_participant
 {
 public:
   virtual ~chat_participant() {}
-  virtual void deliver(const chat_message& msg) = 0;
+  virtual void deliver(const shared_frame& msg) = 0;
+  virtual void replay(const history_ring& history) = 0;  //整批补发历史消息
 };
 
 typedef std::shared_ptr<chat_participant> chat_participant_ptr;
+typedef basic_participant_registry<chat_participant_ptr> participant_registry;
 
 //----------------------------------------------------------------------
-//房间
+//房间：主题在一个分片上的副本
 class chat_room
 {
 public:
-  void join(chat_participant_ptr participant)  //加入
+  explicit chat_room(std::size_t history_depth)
+    : recent_msgs_(history_depth),
+      loaded_(false)
   {
-    participants_.insert(participant);
-    for (auto msg: recent_msgs_)
-      participant->deliver(msg);
   }
 
-  void leave(chat_participant_ptr participant)  //离开
+  registry_handle join(chat_participant_ptr participant)  //加入，返回离开时用的句柄
+  {
+    if (loaded_ && !recent_msgs_.empty())
+      participant->replay(recent_msgs_);
+    return participants_.insert(std::move(participant));
+  }
+
+  void leave(registry_handle handle)  //离开，重复调用无影响
+  {
+    participants_.erase(handle);
+  }
+
+  //装入主题所属分片的历史快照，补发给快照到达前加入的参加者。之后才会有新消息投递过来
+  void load(const frame_batch& history)
   {
-    participants_.erase(participant);
+    for (const auto& msg: history)
+      recent_msgs_.push(msg);
+    loaded_ = true;
+
+    if (!recent_msgs_.empty())
+      for (const auto& participant: participants_)
+        participant->replay(recent_msgs_);
   }
 
-  void deliver(const chat_message& msg) //提交消息
+  void deliver(const shared_frame& msg) //提交消息，只增加引用计数不拷贝数据
   {
-    recent_msgs_.push_back(msg);
-    while (recent_msgs_.size() > max_recent_msgs)
-      recent_msgs_.pop_front();
+    recent_msgs_.push(msg);
 
-    for (auto participant: participants_)
+    for (const auto& participant: participants_)
       participant->deliver(msg);
   }
 
 private:
-  std::set<chat_participant_ptr> participants_; //参加者集合。智能指针
-  enum { max_recent_msgs = 100 };
-  chat_message_queue recent_msgs_;  //消息队列
+  participant_registry participants_; //参加者，连续存储
+  history_ring recent_msgs_;  //最近的消息，与所属分片上的历史一致
+  bool loaded_; //已装入历史快照
+};
+
+//----------------------------------------------------------------------
+//主题路由：一个端口上承载多个房间，帧头里的主题号直接作为下标查表，O(1)
+//每个线程(io_context)是一个分片，持有有订阅者的房间的副本，只在本线程内访问，无需加锁
+//每个主题归一个分片所有(主题号 % 分片数)，由它保存历史、记录哪些分片有房间：
+//消息先按批送到所属分片，再按批转发给有房间的分片，没有房间的分片不会收到
+//分片上新建房间时向所属分片登记并取回历史快照，快照先于之后的消息到达，所以各分片的历史相同
+//同一主题的消息在所有分片上顺序相同
+class topic_router
+{
+public:
+  topic_router(const std::vector<boost::asio::io_context*>& shards,
+      std::size_t history_depth, std::size_t max_topics)
+    : shards_(shards),
+      history_depth_(history_depth)
+  {
+    tables_.reserve(shards.size());
+    for (std::size_t i = 0; i < shards.size(); ++i)
+      tables_.emplace_back(max_topics, shards.size());
+  }
+
+  //订阅，房间在本分片第一次订阅时创建。主题号超出范围时返回false
+  bool subscribe(std::size_t shard, std::uint32_t topic,
+      chat_participant_ptr participant, registry_handle& handle)
+  {
+    std::vector<std::unique_ptr<chat_room> >& rooms = tables_[shard].rooms;
+    if (topic >= rooms.size())
+      return false;
+    if (!rooms[topic])
+    {
+      rooms[topic].reset(new chat_room(history_depth_));
+      open(shard, topic);
+    }
+    handle = rooms[topic]->join(std::move(participant));
+    return true;
+  }
+
+  void unsubscribe(std::size_t shard, std::uint32_t topic, registry_handle handle)
+  {
+    if (chat_room* room = find(shard, topic))
+      room->leave(handle);
+  }
+
+  void deliver(std::size_t shard, const std::vector<shared_frame>& batch)  //在shard线程内调用
+  {
+    if (shards_.size() == 1)
+    {
+      publish(shard, batch);
+      return;
+    }
+
+    std::vector<std::vector<shared_frame> >& routed = tables_[shard].routed;
+    for (const auto& msg: batch)
+      routed[owner(msg.topic())].push_back(msg);
+
+    for (std::size_t i = 0; i < shards_.size(); ++i)  //一次读到的帧对每个所属分片只post一次
+    {
+      if (routed[i].empty())
+        continue;
+      if (i == shard)
+      {
+        publish(i, routed[i]);
+      }
+      else
+      {
+        frame_batch shared_batch(routed[i]);
+        post_thread_cached(*shards_[i],
+            [this, i, shared_batch]()
+            {
+              publish(i, shared_batch);
+            });
+      }
+      routed[i].clear();
+    }
+  }
+
+private:
+  struct topic_state  //主题在所属分片上的状态，第一次有分片订阅时创建
+  {
+    topic_state(std::size_t history_depth, std::size_t shards)
+      : history(history_depth),
+        rooms(shards, false)
+    {
+    }
+
+    history_ring history;     //该主题的历史，各分片新建房间时从这里复制
+    std::vector<bool> rooms;  //哪些分片有该主题的房间
+  };
+
+  std::size_t owner(std::uint32_t topic) const  //主题所属的分片
+  {
+    return topic % shards_.size();
+  }
+
+  std::unique_ptr<topic_state>& state(std::uint32_t topic)  //只在所属分片线程内访问
+  {
+    return tables_[owner(topic)].topics[topic / shards_.size()];
+  }
+
+  chat_room* find(std::size_t shard, std::uint32_t topic)
+  {
+    std::vector<std::unique_ptr<chat_room> >& rooms = tables_[shard].rooms;
+    return topic < rooms.size() ? rooms[topic].get() : nullptr;
+  }
+
+  //新建房间后向所属分片登记，把历史快照送回本分片装入房间
+  void open(std::size_t shard, std::uint32_t topic)
+  {
+    std::size_t o = owner(topic);
+    if (o == shard)
+    {
+      load(shard, topic, snapshot(shard, topic));
+      return;
+    }
+    post_thread_cached(*shards_[o],
+        [this, shard, topic]()
+        {
+          frame_batch history = snapshot(shard, topic);
+          post_thread_cached(*shards_[shard],
+              [this, shard, topic, history]()
+              {
+                load(shard, topic, history);
+              });
+        });
+  }
+
+  void load(std::size_t shard, std::uint32_t topic, const frame_batch& history)
+  {
+    tables_[shard].rooms[topic]->load(history);
+  }
+
+  //在所属分片线程内调用：登记shard有房间，返回当前历史。之后的消息都会转发给shard
+  frame_batch snapshot(std::size_t shard, std::uint32_t topic)
+  {
+    std::unique_ptr<topic_state>& s = state(topic);
+    if (!s)
+      s.reset(new topic_state(history_depth_, shards_.size()));
+    s->rooms[shard] = true;
+
+    std::vector<shared_frame>& frames = tables_[owner(topic)].history;
+    s->history.for_each(
+        [&frames](const shared_frame& msg)
+        {
+          frames.push_back(msg);
+        });
+    frame_batch history(frames);
+    frames.clear();
+    return history;
+  }
+
+  //在所属分片线程内调用：记入历史，按批转发给有房间的分片。超出范围或没有任何分片订阅的主题直接丢弃
+  template <typename Frames>
+  void publish(std::size_t shard, const Frames& frames)
+  {
+    std::vector<std::vector<shared_frame> >& fanout = tables_[shard].fanout;
+    for (const auto& msg: frames)
+    {
+      if (msg.topic() >= tables_[shard].rooms.size())
+        continue;
+      topic_state* s = state(msg.topic()).get();
+      if (!s)
+        continue;
+      s->history.push(msg);
+      for (std::size_t i = 0; i < shards_.size(); ++i)
+        if (s->rooms[i])
+          fanout[i].push_back(msg);
+    }
+
+    for (std::size_t i = 0; i < shards_.size(); ++i)
+    {
+      if (fanout[i].empty())
+        continue;
+      if (i == shard)
+      {
+        deliver_local(i, fanout[i]);
+      }
+      else
+      {
+        frame_batch shared_batch(fanout[i]);
+        post_thread_cached(*shards_[i],
+            [this, i, shared_batch]()
+            {
+              deliver_local(i, shared_batch);
+            });
+      }
+      fanout[i].clear();
+    }
+  }
+
+  template <typename Frames>
+  void deliver_local(std::size_t shard, const Frames& frames)
+  {
+    for (const auto& msg: frames)
+      if (chat_room* room = find(shard, msg.topic()))
+        room->deliver(msg);
+  }
+
+  struct alignas(64) shard_table  //各分片的路由表分属不同缓存行，避免伪共享
+  {
+    shard_table(std::size_t max_topics, std::size_t shards)
+      : rooms(max_topics),
+        topics((max_topics + shards - 1) / shards),
+        routed(shards),
+        fanout(shards)
+    {
+    }
+
+    std::vector<std::unique_ptr<chat_room> > rooms;  //下标为主题号
+    std::vector<std::unique_ptr<topic_state> > topics;  //本分片所有的主题，下标为主题号/分片数
+    std::vector<std::vector<shared_frame> > routed;   //按所属分片分组的待发帧，重复使用
+    std::vector<std::vector<shared_frame> > fanout;   //按目标分片分组的待转发帧，重复使用
+    std::vector<shared_frame> history;  //复制历史快照用
+  };
+
+  std::vector<boost::asio::io_context*> shards_;
+  std::size_t history_depth_;
+  std::vector<shard_table> tables_;
 };
 
 //----------------------------------------------------------------------
@@ -64,77 +328,185 @@ class chat_session
     public std::enable_shared_from_this<chat_session>
 {
 public:
-  chat_session(tcp::socket socket, chat_room& room)
+  chat_session(tcp::socket socket, topic_router& router, std::size_t shard,
+      const chat_options& options, write_queue_totals& write_totals)
     : socket_(std::move(socket)),
-      room_(room)
+      router_(router),
+      shard_(shard),
+      write_totals_(write_totals),
+      reader_(options.max_body_length),
+      write_msgs_(options.max_write_bytes, options.write_limits)
   {
   }
 
   void start()
   {
-    room_.join(shared_from_this());
-    do_read_header();
+    subscribe(0);  //默认加入0号房间，兼容只有一个房间时的客户端
+    do_read();
   }
 
-  void deliver(const chat_message& msg)
+  void reset(tcp::socket socket)  //对象池复用：换上新连接，读缓冲区和发送队列的容量保留
   {
-    bool write_in_progress = !write_msgs_.empty();
-    write_msgs_.push_back(msg);
-    if (!write_in_progress)
+    socket_ = std::move(socket);
+  }
+
+  void recycle()  //最后一个引用释放，所有订阅都已退出
+  {
+    boost::system::error_code ignored_ec;
+    socket_.close(ignored_ec);
+    const write_queue_stats& stats = write_msgs_.stats();
+    if (stats.dropped_frames != 0)  //设置了队列上限并按策略丢过帧
+      std::cerr << "Slow consumer dropped frames=" << stats.dropped_frames
+        << " bytes=" << stats.dropped_bytes
+        << " overflows=" << stats.overflows << "\n";
+    write_totals_.add(stats);
+    subscriptions_.clear();
+    reader_.reset();
+    batch_.clear();
+    write_msgs_.clear();
+  }
+
+  void deliver(const shared_frame& msg)
+  {
+    if (!write_msgs_.push(msg))
+    {
+      disconnect();  //慢速连接
+      return;
+    }
+    if (!write_msgs_.writing())
     {
       do_write();
     }
   }
 
-private:
-  void do_read_header()   //读消息头
+  void replay(const history_ring& history)  //全部入队后只发起一次聚合写
   {
-    auto self(shared_from_this());
-    boost::asio::async_read(socket_,
-        boost::asio::buffer(read_msg_.data(), chat_message::header_length),
-        [this, self](boost::system::error_code ec, std::size_t /*length*/)
+    bool ok = true;
+    history.for_each(
+        [this, &ok](const shared_frame& msg)
         {
-          if (!ec && read_msg_.decode_header())
-          {
-            do_read_body();
-          }
-          else
-          {
-            room_.leave(shared_from_this());
-          }
+          ok = ok && write_msgs_.push(msg);
         });
+    if (!ok)
+    {
+      disconnect();
+      return;
+    }
+    if (!write_msgs_.writing())
+    {
+      do_write();
+    }
+  }
+
+private:
+  //正在遍历房间参加者，不能直接leave；关闭socket后由未完成的读写回调leave
+  void disconnect()
+  {
+    if (!socket_.is_open())
+      return;
+    const write_queue_stats& stats = write_msgs_.stats();
+    std::cerr << "Disconnecting slow consumer: queued=" << write_msgs_.size()
+      << " bytes=" << write_msgs_.bytes()
+      << " overflows=" << stats.overflows << "\n";
+    boost::system::error_code ignored_ec;
+    socket_.close(ignored_ec);
   }
 
-  void do_read_body() //读消息体
+  void do_read()  //一次读入大块数据，拆出其中所有完整的帧
   {
     auto self(shared_from_this());
-    boost::asio::async_read(socket_,
-        boost::asio::buffer(read_msg_.body(), read_msg_.body_length()),
-        [this, self](boost::system::error_code ec, std::size_t /*length*/)
+    socket_.async_read_some(reader_.prepare(),
+        [this, self](boost::system::error_code ec, std::size_t length)
         {
           if (!ec)
           {
-            room_.deliver(read_msg_);
-            do_read_header();
-          }
-          else
-          {
-            room_.leave(shared_from_this());
+            reader_.commit(length);
+            frame_view f;
+            while (reader_.next(f))
+            {
+              if (f.topic == frame_header::control_topic)
+              {
+                flush();  //控制帧之前的消息先按原顺序投递
+                control(f);
+              }
+              else
+              {
+                batch_.push_back(shared_frame(f));
+              }
+            }
+            flush();
+            if (!reader_.bad())
+            {
+              do_read();
+              return;
+            }
           }
+          leave_all();
         });
   }
 
-  void do_write() //写消息
+  void flush()
+  {
+    if (batch_.empty())
+      return;
+    router_.deliver(shard_, batch_);
+    batch_.clear();
+  }
+
+  void control(const frame_view& f)  //处理订阅/退订
+  {
+    const char* p = f.body();
+    for (std::size_t n = f.body_length / control_entry::length; n > 0; --n)
+    {
+      std::uint32_t topic = frame_header::load_u32(p + 1);
+      if (p[0] == control_entry::subscribe)
+        subscribe(topic);
+      else if (p[0] == control_entry::unsubscribe)
+        unsubscribe(topic);
+      p += control_entry::length;
+    }
+  }
+
+  void subscribe(std::uint32_t topic)
+  {
+    for (const auto& s: subscriptions_)
+      if (s.first == topic)
+        return;
+    registry_handle handle;
+    if (router_.subscribe(shard_, topic, shared_from_this(), handle))
+      subscriptions_.emplace_back(topic, handle);
+  }
+
+  void unsubscribe(std::uint32_t topic)
+  {
+    for (auto it = subscriptions_.begin(); it != subscriptions_.end(); ++it)
+    {
+      if (it->first == topic)
+      {
+        router_.unsubscribe(shard_, topic, it->second);
+        *it = subscriptions_.back();
+        subscriptions_.pop_back();
+        return;
+      }
+    }
+  }
+
+  void leave_all()  //读写出错时离开所有房间，重复调用无影响
+  {
+    for (const auto& s: subscriptions_)
+      router_.unsubscribe(shard_, s.first, s.second);
+    subscriptions_.clear();
+  }
+
+  void do_write() //把排队的消息聚合成一次写
   {
     auto self(shared_from_this());
-    boost::asio::async_write(socket_,
-        boost::asio::buffer(write_msgs_.front().data(),
-          write_msgs_.front().length()),
+    boost::asio::async_write(socket_, write_msgs_.prepare(),
         [this, self](boost::system::error_code ec, std::size_t /*length*/)
         {
           if (!ec)
           {
-            write_msgs_.pop_front();
+            write_msgs_.consume();
             if (!write_msgs_.empty())
             {
               do_write();
@@ -142,15 +514,19 @@ private:
           }
           else
           {
-            room_.leave(shared_from_this());
+            leave_all();
           }
         });
   }
 
-  tcp::socket socket_;
-  chat_room& room_;
-  chat_message read_msg_;
-  chat_message_queue write_msgs_;
+  thread_cached_io<tcp::socket> socket_;  //异步操作的处理函数使用线程缓存
+  topic_router& router_;
+  std::size_t shard_;   //所属分片(线程)
+  write_queue_totals& write_totals_;  //本分片已结束会话的发送队列计数
+  std::vector<std::pair<std::uint32_t, registry_handle> > subscriptions_;  //已订阅的主题
+  frame_reader reader_;
+  std::vector<shared_frame> batch_;  //一次读到的帧
+  write_queue write_msgs_;
 };
 
 //----------------------------------------------------------------------
@@ -158,30 +534,148 @@ private:
 class chat_server
 {
 public:
-  chat_server(boost::asio::io_context& io_context,
-      const tcp::endpoint& endpoint)
-    : acceptor_(io_context, endpoint)
+  chat_server(const std::vector<boost::asio::io_context*>& shards,
+      const tcp::endpoint& endpoint,
+      const chat_options& options = chat_options())
+    : shards_(shards),
+      options_(options),
+      router_(shards, options.history_depth, options.max_topics),
+      accepted_(shards.size(), 0),
+      next_shard_(0)
+  {
+    for (std::size_t i = 0; i < shards.size(); ++i)  //每个分片一个会话池，只在该分片线程里使用
+    {
+      sessions_.emplace_back(new session_pool<chat_session>(options.max_idle_sessions));
+      write_totals_.emplace_back(new write_queue_totals);
+    }
+
+    if (options.reuse_port)
+    {
+      for (std::size_t i = 0; i < shards.size(); ++i)  //内核把连接分给各个分片，不经过其他线程
+      {
+        acceptors_.emplace_back(new thread_cached_io<tcp::acceptor>(*shards[i]));
+        open_acceptor(*acceptors_.back(), endpoint, true);
+        do_accept_local(i);
+      }
+    }
+    else
+    {
+      acceptors_.emplace_back(new thread_cached_io<tcp::acceptor>(*shards.front()));
+      open_acceptor(*acceptors_.back(), endpoint, false);
+      do_accept();
+    }
+  }
+
+  const std::vector<std::size_t>& accepted() const  //各分片接受的连接数，线程结束后读取
+  {
+    return accepted_;
+  }
+
+  void write_stats(write_queue_stats& total) const  //把各分片已结束会话的发送队列计数累加到total，任何线程都可以调用
   {
-    do_accept();
+    for (const auto& t: write_totals_)
+      t->load(total);
   }
 
 private:
   void do_accept()
   {
-    acceptor_.async_accept(
-        [this](boost::system::error_code ec, tcp::socket socket)
+    std::size_t shard = next_shard_++ % shards_.size();  //轮流分配到各个分片
+    acceptors_.front()->async_accept(*shards_[shard],
+        [this, shard](boost::system::error_code ec, tcp::socket socket)
         {
           if (!ec)
           {
-            std::make_shared<chat_session>(std::move(socket), room_)->start();
+            //在连接所属的分片线程里创建会话
+            post_thread_cached(*shards_[shard],
+                [this, shard, socket = std::move(socket)]() mutable
+                {
+                  start_session(shard, std::move(socket));
+                });
           }
 
           do_accept();
         });
   }
 
-  tcp::acceptor acceptor_;
-  chat_room room_;
+  void do_accept_local(std::size_t shard)  //在本分片线程里接受并创建会话
+  {
+    acceptors_[shard]->async_accept(
+        [this, shard](boost::system::error_code ec, tcp::socket socket)
+        {
+          if (!ec)
+          {
+            start_session(shard, std::move(socket));
+          }
+
+          do_accept_local(shard);
+        });
+  }
+
+  void start_session(std::size_t shard, tcp::socket socket)
+  {
+    ++accepted_[shard];
+    sessions_[shard]->acquire(std::move(socket), router_,
+        shard, options_, *write_totals_[shard])->start();
+  }
+
+  std::vector<boost::asio::io_context*> shards_;
+  std::vector<std::unique_ptr<thread_cached_io<tcp::acceptor> > > acceptors_;
+  chat_options options_;
+  topic_router router_;
+  std::vector<std::unique_ptr<session_pool<chat_session> > > sessions_;
+  std::vector<std::unique_ptr<write_queue_totals> > write_totals_;  //每个元素只由对应分片线程add
+  std::vector<std::size_t> accepted_;  //每个元素只由对应分片线程修改
+  std::size_t next_shard_;
+};
+
+//----------------------------------------------------------------------
+//定期打印帧内存池和处理函数缓存的计数，稳定运行时heap_allocations不再增长
+//以及已结束会话的发送队列计数：丢帧总数和单个连接的最高排队帧数/字节数
+class pool_reporter
+{
+public:
+  pool_reporter(boost::asio::io_context& io_context, std::size_t seconds,
+      const std::list<chat_server>& servers)
+    : timer_(io_context),
+      interval_(seconds),
+      servers_(servers)
+  {
+    do_wait();
+  }
+
+private:
+  void do_wait()
+  {
+    timer_.expires_after(interval_);
+    timer_.async_wait(
+        [this](boost::system::error_code ec)
+        {
+          if (ec)
+            return;
+          frame_pool_stats stats = frame_pool::total_stats();
+          std::cerr << "frame_pool: allocations=" << stats.allocations
+            << " heap_allocations=" << stats.heap_allocations
+            << " remote_frees=" << stats.remote_frees << "\n";
+          thread_cache_stats handlers = thread_cache::total_stats();
+          std::cerr << "thread_cache: allocations=" << handlers.allocations
+            << " heap_allocations=" << handlers.heap_allocations
+            << " remote_frees=" << handlers.remote_frees << "\n";
+          write_queue_stats writes;
+          for (const chat_server& server: servers_)
+            server.write_stats(writes);
+          std::cerr << "write_queue: dropped_frames=" << writes.dropped_frames
+            << " dropped_bytes=" << writes.dropped_bytes
+            << " overflows=" << writes.overflows
+            << " high_water_frames=" << writes.high_water_frames
+            << " high_water_bytes=" << writes.high_water_bytes << "\n";
+          do_wait();
+        });
+  }
+
+  boost::asio::steady_timer timer_;
+  std::chrono::seconds interval_;
+  const std::list<chat_server>& servers_;
 };
 
 //----------------------------------------------------------------------
@@ -190,22 +684,78 @@ int main(int argc, char* argv[])
 {
   try
   {
-    if (argc < 2)
+    chat_options options;
+    std::size_t threads = 1;
+    std::size_t report_seconds = 0;
+    int arg = 1;
+    for (; arg + 1 < argc && argv[arg][0] == '-'; arg += 2)
+    {
+      if (std::strcmp(argv[arg], "-t") == 0)  //线程(分片)数
+        threads = std::strtoul(argv[arg + 1], nullptr, 10);  //0表示每个核一个
+      else if (std::strcmp(argv[arg], "-s") == 0)  //打印内存池计数的间隔(秒)
+        report_seconds = std::strtoul(argv[arg + 1], nullptr, 10);
+      else if (std::strcmp(argv[arg], "-r") == 0)  //历史消息条数
+        options.history_depth = std::strtoul(argv[arg + 1], nullptr, 10);
+      else if (std::strcmp(argv[arg], "-n") == 0)  //主题数
+        options.max_topics = std::strtoul(argv[arg + 1], nullptr, 10);
+      else if (std::strcmp(argv[arg], "-a") == 0 && std::strcmp(argv[arg + 1], "reuseport") == 0)
+        options.reuse_port = true;  //每个分片独立监听并绑定CPU
+      else if (std::strcmp(argv[arg], "-a") == 0 && std::strcmp(argv[arg + 1], "roundrobin") == 0)
+        options.reuse_port = false;
+      else if (std::strcmp(argv[arg], "-i") == 0)  //每个分片缓存的空闲会话数
+        options.max_idle_sessions = std::strtoul(argv[arg + 1], nullptr, 10);
+      else if (std::strcmp(argv[arg], "-l") == 0)  //包体最大长度(上限16MB)，客户端用同样的-l
+        options.max_body_length = std::strtoul(argv[arg + 1], nullptr, 10);
+      else if (std::strcmp(argv[arg], "-w") == 0)  //聚合写字节上限
+        options.max_write_bytes = std::strtoul(argv[arg + 1], nullptr, 10);
+      else if (std::strcmp(argv[arg], "-q") == 0)  //发送队列帧数上限
+        options.write_limits.max_frames = std::strtoul(argv[arg + 1], nullptr, 10);
+      else if (std::strcmp(argv[arg], "-b") == 0)  //发送队列字节上限
+        options.write_limits.max_bytes = std::strtoul(argv[arg + 1], nullptr, 10);
+      else if (std::strcmp(argv[arg], "-p") == 0 && std::strcmp(argv[arg + 1], "drop_oldest") == 0)
+        options.write_limits.policy = overflow_policy::drop_oldest;
+      else if (std::strcmp(argv[arg], "-p") == 0 && std::strcmp(argv[arg + 1], "drop_newest") == 0)
+        options.write_limits.policy = overflow_policy::drop_newest;
+      else if (std::strcmp(argv[arg], "-p") == 0 && std::strcmp(argv[arg + 1], "disconnect") == 0)
+        options.write_limits.policy = overflow_policy::disconnect;
+      else
+        break;
+    }
+
+    if (arg >= argc || argv[arg][0] == '-')
     {
-      std::cerr << "Usage: chat_server <port> [<port> ...]\n";
+      std::cerr << "Usage: chat_server [-t <threads>] [-s <report_seconds>] [-r <history_depth>] [-n <max_topics>] [-i <max_idle_sessions>] [-a roundrobin|reuseport] [-l <max_body_length>] [-w <max_write_bytes>] [-q <max_queued_frames>]"
+        " [-b <max_queued_bytes>] [-p drop_oldest|drop_newest|disconnect]"
+        " <port> [<port> ...]\n";
       return 1;
     }
 
-    boost::asio::io_context io_context;
+    //每个线程一个io_context；reuseport模式下各线程绑定CPU
+    io_context_per_core contexts(threads, options.reuse_port);
+    std::vector<boost::asio::io_context*> shards = contexts.contexts();
 
     std::list<chat_server> servers;  //服务器列表
-    for (int i = 1; i < argc; ++i)
+    for (int i = arg; i < argc; ++i)
     {
       tcp::endpoint endpoint(tcp::v4(), std::atoi(argv[i]));
-      servers.emplace_back(io_context, endpoint);
+      servers.emplace_back(shards, endpoint, options);
     }
 
-    io_context.run();
+    std::unique_ptr<pool_reporter> reporter;
+    if (report_seconds != 0)
+      reporter.reset(new pool_reporter(*shards.front(), report_seconds, servers));
+
+    boost::asio::signal_set signals(*shards.front(), SIGINT, SIGTERM);  //退出时打印连接分布
+    signals.async_wait(
+        [&contexts](boost::system::error_code /*ec*/, int /*signo*/)
+        {
+          contexts.stop();
+        });
+
+    contexts.run();
+
+    for (const chat_server& server: servers)
+      print_connection_distribution(std::cout, server.accepted());
   }
   catch (std::exception& e)
   {
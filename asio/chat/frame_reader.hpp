@@ -0,0 +1,134 @@
+//流式拆包：一次读入大块数据，在缓冲区内原地切出所有完整帧
+#ifndef FRAME_READER_HPP
+#define FRAME_READER_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#include <boost/asio/buffer.hpp>
+#include "chat_frame.hpp"
+//--------------------------------
+//帧视图，指向读缓冲区内部，下一次prepare()之前有效
+struct frame_view
+{
+  const char* data;         //包头起始
+  std::size_t body_length;
+  std::uint32_t topic;
+
+  const char* body() const
+  {
+    return data + frame_header::length;
+  }
+
+  std::size_t length() const
+  {
+    return frame_header::length + body_length;
+  }
+};
+//--------------------------------
+//帧读取器
+//用法：async_read_some(reader.prepare(), ...) -> commit(n) -> while (next(f)) ...
+//缓冲区从chunk_size开始，包头声明的帧放不下时才扩大到刚好容纳它，reset()时缩回chunk_size
+class frame_reader
+{
+public:
+  enum : std::size_t { default_chunk_size = 64 * 1024 };
+
+  explicit frame_reader(
+      std::size_t max_body_length = chat_frame::default_max_body_length,
+      std::size_t chunk_size = default_chunk_size)
+    : max_body_length_(max_body_length < chat_frame::max_body_limit
+          ? max_body_length : chat_frame::max_body_limit),
+      chunk_size_(std::max<std::size_t>(chunk_size, frame_header::length)),
+      buffer_(chunk_size_),
+      begin_(0),
+      end_(0),
+      pending_(0),
+      bad_(false)
+  {
+  }
+
+  frame_reader(const frame_reader&) = delete;
+  frame_reader& operator=(const frame_reader&) = delete;
+
+  //返回可写入的空闲空间。只把未拆完的尾部搬到缓冲区开头，放不下未完成的帧时扩大
+  boost::asio::mutable_buffer prepare()
+  {
+    if (begin_ != 0)
+    {
+      std::size_t tail = end_ - begin_;
+      if (tail != 0)
+        std::memmove(buffer_.data(), buffer_.data() + begin_, tail);
+      begin_ = 0;
+      end_ = tail;
+    }
+    if (pending_ > buffer_.size())
+      buffer_.resize(pending_);
+    return boost::asio::buffer(buffer_.data() + end_, buffer_.size() - end_);
+  }
+
+  void commit(std::size_t n)  //读到了n个字节
+  {
+    end_ += n;
+  }
+
+  //取出下一个完整帧；数据不足或包体超长时返回false
+  bool next(frame_view& f)
+  {
+    std::size_t avail = end_ - begin_;
+    if (avail < frame_header::length)
+      return false;
+
+    const char* p = buffer_.data() + begin_;
+    std::size_t body_length = frame_header::decode(p);
+    if (body_length > max_body_length_)
+    {
+      bad_ = true;
+      return false;
+    }
+    if (avail - frame_header::length < body_length)
+    {
+      pending_ = frame_header::length + body_length;  //下一次prepare()保证放得下
+      return false;
+    }
+
+    f.data = p;
+    f.body_length = body_length;
+    f.topic = frame_header::decode_topic(p);
+    begin_ += frame_header::length + body_length;
+    return true;
+  }
+
+  void reset()  //丢弃已读数据(连接对象复用)。为大帧扩大过的缓冲区缩回chunk_size，空闲对象不占用
+  {
+    if (buffer_.size() > chunk_size_)
+      std::vector<char>(chunk_size_).swap(buffer_);
+    begin_ = 0;
+    end_ = 0;
+    pending_ = 0;
+    bad_ = false;
+  }
+
+  bool bad() const  //收到非法包头，应断开连接
+  {
+    return bad_;
+  }
+
+  std::size_t max_body_length() const
+  {
+    return max_body_length_;
+  }
+
+private:
+  std::size_t max_body_length_;
+  std::size_t chunk_size_;
+  std::vector<char> buffer_;  //能容纳当前未完成的帧
+  std::size_t begin_;         //未处理数据起点
+  std::size_t end_;           //已读数据终点
+  std::size_t pending_;       //未完成的帧的总长度
+  bool bad_;
+};
+
+#endif // FRAME_READER_HPP
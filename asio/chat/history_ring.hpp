@@ -0,0 +1,71 @@
+//历史消息环形缓冲区：固定容量、连续存储，写满后覆盖最早的消息
+#ifndef HISTORY_RING_HPP
+#define HISTORY_RING_HPP
+
+#include <cstddef>
+#include <vector>
+//--------------------------------
+//容量在构造时确定，之后push不再分配内存
+template <typename Frame>
+class basic_history_ring
+{
+public:
+  explicit basic_history_ring(std::size_t capacity)
+    : frames_(capacity),
+      head_(0),
+      size_(0)
+  {
+  }
+
+  std::size_t capacity() const
+  {
+    return frames_.size();
+  }
+
+  std::size_t size() const
+  {
+    return size_;
+  }
+
+  bool empty() const
+  {
+    return size_ == 0;
+  }
+
+  void push(const Frame& f)  //满了就覆盖最早的一条
+  {
+    std::size_t capacity = frames_.size();
+    if (capacity == 0)
+      return;
+
+    std::size_t tail = head_ + size_;
+    if (tail >= capacity)
+      tail -= capacity;
+    frames_[tail] = f;
+
+    if (size_ < capacity)
+      ++size_;
+    else if (++head_ == capacity)
+      head_ = 0;
+  }
+
+  template <typename Function>
+  void for_each(Function f) const  //从最早到最新依次访问
+  {
+    std::size_t capacity = frames_.size();
+    std::size_t i = head_;
+    for (std::size_t n = 0; n < size_; ++n)
+    {
+      f(frames_[i]);
+      if (++i == capacity)
+        i = 0;
+    }
+  }
+
+private:
+  std::vector<Frame> frames_;
+  std::size_t head_;  //最早一条的位置
+  std::size_t size_;
+};
+
+#endif // HISTORY_RING_HPP
@@ -0,0 +1,101 @@
+//参加者登记表：连续数组存储，广播时顺序遍历；删除时与末尾元素交换，加入和离开都是O(1)
+#ifndef PARTICIPANT_REGISTRY_HPP
+#define PARTICIPANT_REGISTRY_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+//--------------------------------
+//句柄：槽位下标+版本号。元素在数组中移动时句柄不变；槽位复用后旧句柄失效
+struct registry_handle
+{
+  std::uint32_t slot = invalid_slot;
+  std::uint32_t generation = 0;
+
+  enum : std::uint32_t { invalid_slot = 0xffffffffu };
+};
+//--------------------------------
+template <typename T>
+class basic_participant_registry
+{
+public:
+  typedef typename std::vector<T>::const_iterator const_iterator;
+
+  registry_handle insert(T value)
+  {
+    registry_handle h;
+    if (!free_.empty())
+    {
+      h.slot = free_.back();
+      free_.pop_back();
+    }
+    else
+    {
+      h.slot = static_cast<std::uint32_t>(slots_.size());
+      slots_.push_back(slot());
+    }
+
+    slot& s = slots_[h.slot];
+    s.index = dense_.size();
+    h.generation = s.generation;
+    dense_.push_back(std::move(value));
+    owners_.push_back(h.slot);
+    return h;
+  }
+
+  bool erase(registry_handle h)  //重复删除或句柄过期时返回false
+  {
+    if (h.slot >= slots_.size() || slots_[h.slot].generation != h.generation)
+      return false;
+
+    slot& s = slots_[h.slot];
+    std::size_t last = dense_.size() - 1;
+    if (s.index != last)  //末尾元素填补空位
+    {
+      dense_[s.index] = std::move(dense_[last]);
+      owners_[s.index] = owners_[last];
+      slots_[owners_[s.index]].index = s.index;
+    }
+    dense_.pop_back();
+    owners_.pop_back();
+
+    ++s.generation;
+    free_.push_back(h.slot);
+    return true;
+  }
+
+  std::size_t size() const
+  {
+    return dense_.size();
+  }
+
+  bool empty() const
+  {
+    return dense_.empty();
+  }
+
+  const_iterator begin() const
+  {
+    return dense_.begin();
+  }
+
+  const_iterator end() const
+  {
+    return dense_.end();
+  }
+
+private:
+  struct slot
+  {
+    std::size_t index = 0;            //在dense_中的位置
+    std::uint32_t generation = 0;
+  };
+
+  std::vector<T> dense_;              //遍历用的连续数组
+  std::vector<std::uint32_t> owners_; //dense_[i]对应的槽位
+  std::vector<slot> slots_;
+  std::vector<std::uint32_t> free_;   //空闲槽位
+};
+
+#endif // PARTICIPANT_REGISTRY_HPP
@@ -0,0 +1,158 @@
+//共享只读帧：编码好的帧只拷贝一次，所有连接的写队列和历史消息共享同一份数据
+//帧存储来自frame_pool，稳定运行后不再分配内存
+#ifndef SHARED_FRAME_HPP
+#define SHARED_FRAME_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include <utility>
+#include <vector>
+#include <boost/asio/buffer.hpp>
+#include "../allocation/frame_pool.hpp"
+#include "chat_frame.hpp"
+#include "frame_reader.hpp"
+//--------------------------------
+//引用计数的只读帧，可直接作为ConstBufferSequence传给async_write
+//数据和引用计数在同一个内存池块里，拷贝只增加计数
+class shared_frame
+{
+public:
+  shared_frame()
+    : block_(nullptr)
+  {
+  }
+
+  explicit shared_frame(const frame_view& f)  //从读缓冲区拷贝一次
+    : block_(nullptr)
+  {
+    assign(f.data, f.length());
+  }
+
+  explicit shared_frame(const chat_frame& f)
+    : block_(nullptr)
+  {
+    assign(f.data(), f.length());
+  }
+
+  shared_frame(const shared_frame& other)
+    : block_(other.block_),
+      buffer_(other.buffer_)
+  {
+    if (block_)
+      block_->refs.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  shared_frame(shared_frame&& other) noexcept
+    : block_(other.block_),
+      buffer_(other.buffer_)
+  {
+    other.block_ = nullptr;
+    other.buffer_ = boost::asio::const_buffer();
+  }
+
+  shared_frame& operator=(shared_frame other) noexcept
+  {
+    std::swap(block_, other.block_);
+    std::swap(buffer_, other.buffer_);
+    return *this;
+  }
+
+  ~shared_frame()
+  {
+    if (block_ && block_->refs.fetch_sub(1, std::memory_order_acq_rel) == 1)
+      frame_pool::recycle(block_);
+  }
+
+  typedef boost::asio::const_buffer value_type;
+  typedef const boost::asio::const_buffer* const_iterator;
+  const boost::asio::const_buffer* begin() const { return &buffer_; }
+  const boost::asio::const_buffer* end() const { return &buffer_ + 1; }
+
+  const char* data() const
+  {
+    return static_cast<const char*>(buffer_.data());
+  }
+
+  std::size_t length() const
+  {
+    return buffer_.size();
+  }
+
+  const char* body() const
+  {
+    return data() + frame_header::length;
+  }
+
+  std::size_t body_length() const
+  {
+    return buffer_.size() - frame_header::length;
+  }
+
+  std::uint32_t topic() const
+  {
+    return frame_header::decode_topic(data());
+  }
+
+private:
+  void assign(const char* data, std::size_t length)
+  {
+    block_ = frame_pool::allocate(length);
+    std::memcpy(block_->data(), data, length);
+    buffer_ = boost::asio::const_buffer(block_->data(), length);
+  }
+
+  pool_block* block_;
+  boost::asio::const_buffer buffer_;
+};
+//--------------------------------
+//一批帧，引用计数。跨分片投递时各分片共享同一批，数组本身也从内存池分配
+class frame_batch
+{
+public:
+  explicit frame_batch(const std::vector<shared_frame>& frames)
+    : block_(frame_pool::allocate(frames.size() * sizeof(shared_frame))),
+      size_(frames.size())
+  {
+    shared_frame* p = reinterpret_cast<shared_frame*>(block_->data());
+    for (std::size_t i = 0; i < size_; ++i)
+      new (p + i) shared_frame(frames[i]);
+  }
+
+  frame_batch(const frame_batch& other)
+    : block_(other.block_),
+      size_(other.size_)
+  {
+    block_->refs.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  frame_batch& operator=(const frame_batch&) = delete;
+
+  ~frame_batch()
+  {
+    if (block_->refs.fetch_sub(1, std::memory_order_acq_rel) == 1)
+    {
+      shared_frame* p = reinterpret_cast<shared_frame*>(block_->data());
+      for (std::size_t i = 0; i < size_; ++i)
+        p[i].~shared_frame();
+      frame_pool::recycle(block_);
+    }
+  }
+
+  const shared_frame* begin() const
+  {
+    return reinterpret_cast<const shared_frame*>(block_->data());
+  }
+
+  const shared_frame* end() const
+  {
+    return begin() + size_;
+  }
+
+private:
+  pool_block* block_;
+  std::size_t size_;
+};
+
+#endif // SHARED_FRAME_HPP
@@ -0,0 +1,285 @@
+//写队列：把排队的多个帧聚合成一个scatter/gather缓冲区序列，一次async_write(writev)发出
+//可以设置帧数和字节数上限(默认不限制)，慢速连接按策略丢帧或断开
+#ifndef WRITE_QUEUE_HPP
+#define WRITE_QUEUE_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <utility>
+#include <vector>
+#include <boost/asio/buffer.hpp>
+//--------------------------------
+//聚合缓冲区序列的轻量视图，async_write拷贝它时不会拷贝vector
+class gather_buffers
+{
+public:
+  gather_buffers(const boost::asio::const_buffer* first,
+      const boost::asio::const_buffer* last)
+    : begin_(first),
+      end_(last)
+  {
+  }
+
+  typedef boost::asio::const_buffer value_type;
+  typedef const boost::asio::const_buffer* const_iterator;
+  const boost::asio::const_buffer* begin() const { return begin_; }
+  const boost::asio::const_buffer* end() const { return end_; }
+
+private:
+  const boost::asio::const_buffer* begin_;
+  const boost::asio::const_buffer* end_;
+};
+//--------------------------------
+//先进先出队列，vector加头部下标实现。与std::deque不同，稳定运行后不再分配/释放内存块
+template <typename Frame>
+class frame_fifo
+{
+public:
+  frame_fifo()
+    : head_(0)
+  {
+  }
+
+  bool empty() const
+  {
+    return head_ == items_.size();
+  }
+
+  std::size_t size() const
+  {
+    return items_.size() - head_;
+  }
+
+  Frame& front()
+  {
+    return items_[head_];
+  }
+
+  void push_back(const Frame& f)
+  {
+    if (head_ != 0 && head_ * 2 >= items_.size())  //前面空出一半以上时整体前移
+    {
+      items_.erase(items_.begin(), items_.begin() + head_);
+      head_ = 0;
+    }
+    items_.push_back(f);
+  }
+
+  void pop_front()
+  {
+    Frame released(std::move(items_[head_]));  //立即释放帧的引用
+    if (++head_ == items_.size())
+    {
+      items_.clear();  //保留容量
+      head_ = 0;
+    }
+  }
+
+  void clear()
+  {
+    items_.clear();
+    head_ = 0;
+  }
+
+private:
+  std::vector<Frame> items_;
+  std::size_t head_;
+};
+//--------------------------------
+//队列满时的处理策略
+enum class overflow_policy
+{
+  drop_oldest,  //丢弃最早的未发送帧
+  drop_newest,  //丢弃新到的帧
+  disconnect    //断开慢速连接
+};
+
+//队列上限：帧数和字节数(包括正在发送的帧)，默认不限制，由服务器按需开启
+struct write_queue_limits
+{
+  std::size_t max_frames = std::numeric_limits<std::size_t>::max();
+  std::size_t max_bytes = std::numeric_limits<std::size_t>::max();
+  overflow_policy policy = overflow_policy::drop_oldest;
+};
+
+//计数器
+struct write_queue_stats
+{
+  std::size_t dropped_frames = 0;
+  std::size_t dropped_bytes = 0;
+  std::size_t overflows = 0;          //触发上限的次数
+  std::size_t high_water_frames = 0;
+  std::size_t high_water_bytes = 0;
+};
+
+//多个队列的计数汇总：丢帧数相加，高水位取最大。只由一个线程add，其他线程可以随时load
+class write_queue_totals
+{
+public:
+  void add(const write_queue_stats& s)
+  {
+    increase(dropped_frames_, s.dropped_frames);
+    increase(dropped_bytes_, s.dropped_bytes);
+    increase(overflows_, s.overflows);
+    raise(high_water_frames_, s.high_water_frames);
+    raise(high_water_bytes_, s.high_water_bytes);
+  }
+
+  void load(write_queue_stats& s) const  //累加到s上，可以汇总多个
+  {
+    s.dropped_frames += dropped_frames_.load(std::memory_order_relaxed);
+    s.dropped_bytes += dropped_bytes_.load(std::memory_order_relaxed);
+    s.overflows += overflows_.load(std::memory_order_relaxed);
+    s.high_water_frames = std::max<std::size_t>(s.high_water_frames,
+        high_water_frames_.load(std::memory_order_relaxed));
+    s.high_water_bytes = std::max<std::size_t>(s.high_water_bytes,
+        high_water_bytes_.load(std::memory_order_relaxed));
+  }
+
+private:
+  //只有一个线程写，不需要原子加
+  static void increase(std::atomic<std::uint64_t>& counter, std::size_t n)
+  {
+    counter.store(counter.load(std::memory_order_relaxed) + n,
+        std::memory_order_relaxed);
+  }
+
+  static void raise(std::atomic<std::uint64_t>& counter, std::size_t n)
+  {
+    if (n > counter.load(std::memory_order_relaxed))
+      counter.store(n, std::memory_order_relaxed);
+  }
+
+  std::atomic<std::uint64_t> dropped_frames_{0};
+  std::atomic<std::uint64_t> dropped_bytes_{0};
+  std::atomic<std::uint64_t> overflows_{0};
+  std::atomic<std::uint64_t> high_water_frames_{0};
+  std::atomic<std::uint64_t> high_water_bytes_{0};
+};
+//--------------------------------
+//Frame需要提供data()和length()，如chat_frame、shared_frame
+template <typename Frame>
+class basic_write_queue
+{
+public:
+  enum : std::size_t { default_max_write_bytes = 64 * 1024 };
+
+  explicit basic_write_queue(
+      std::size_t max_write_bytes = default_max_write_bytes,
+      const write_queue_limits& limits = write_queue_limits())
+    : max_write_bytes_(max_write_bytes),
+      limits_(limits),
+      bytes_(0)
+  {
+  }
+
+  bool empty() const  //是否还有未发送的帧
+  {
+    return frames_.empty();
+  }
+
+  std::size_t size() const
+  {
+    return frames_.size() + sending_.size();
+  }
+
+  std::size_t bytes() const
+  {
+    return bytes_;
+  }
+
+  bool writing() const  //是否有聚合写正在进行
+  {
+    return !sending_.empty();
+  }
+
+  const write_queue_stats& stats() const
+  {
+    return stats_;
+  }
+
+  //入队。超过上限时按策略丢帧；策略为disconnect时返回false，调用者应断开连接
+  bool push(const Frame& f)
+  {
+    while (size() >= limits_.max_frames
+        || f.length() > limits_.max_bytes - bytes_)
+    {
+      ++stats_.overflows;
+      if (limits_.policy == overflow_policy::disconnect)
+        return false;
+
+      if (limits_.policy == overflow_policy::drop_newest || frames_.empty())
+      {
+        drop(f);  //正在发送的帧不能丢
+        return true;
+      }
+
+      drop(frames_.front());
+      bytes_ -= frames_.front().length();
+      frames_.pop_front();
+    }
+
+    frames_.push_back(f);
+    bytes_ += f.length();
+    if (size() > stats_.high_water_frames)
+      stats_.high_water_frames = size();
+    if (bytes_ > stats_.high_water_bytes)
+      stats_.high_water_bytes = bytes_;
+    return true;
+  }
+
+  //从队头取出待发送的帧，总字节数不超过上限(至少一帧)
+  gather_buffers prepare()
+  {
+    std::size_t bytes = 0;
+    while (!frames_.empty())
+    {
+      const Frame& f = frames_.front();
+      if (!sending_.empty() && bytes + f.length() > max_write_bytes_)
+        break;
+      bytes += f.length();
+      sending_.push_back(std::move(frames_.front()));
+      frames_.pop_front();
+    }
+
+    gather_.clear();
+    for (const Frame& f : sending_)
+      gather_.push_back(boost::asio::buffer(f.data(), f.length()));
+    return gather_buffers(gather_.data(), gather_.data() + gather_.size());
+  }
+
+  void consume()  //聚合写完成，释放已发送的帧
+  {
+    for (const Frame& f : sending_)
+      bytes_ -= f.length();
+    sending_.clear();
+  }
+
+  void clear()  //丢弃所有帧、计数清零，容量保留(连接对象复用)
+  {
+    frames_.clear();
+    sending_.clear();
+    bytes_ = 0;
+    stats_ = write_queue_stats();
+  }
+
+private:
+  void drop(const Frame& f)
+  {
+    ++stats_.dropped_frames;
+    stats_.dropped_bytes += f.length();
+  }
+
+  frame_fifo<Frame> frames_;      //未发送
+  std::vector<Frame> sending_;    //正在发送，写完成前不会被修改
+  std::vector<boost::asio::const_buffer> gather_;  //复用，稳定后不再分配
+  std::size_t max_write_bytes_;
+  write_queue_limits limits_;
+  std::size_t bytes_;
+  write_queue_stats stats_;
+};
+
+#endif // WRITE_QUEUE_HPP
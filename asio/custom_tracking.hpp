@@ -1,10 +1,11 @@
-//程序跟踪
+//程序跟踪：每条记录写进当前线程的无锁队列，由后台线程写到ASIO_TRACE_FILE(默认asio_trace.bin)
+//用tracking/trace_decode离线还原成文本和handler树
 #ifndef CUSTOM_TRACKING_HPP
 #define CUSTOM_TRACKING_HPP
 
-#include <cinttypes>
+#include <atomic>
 #include <cstdint>
-#include <cstdio>
+#include "tracking/trace_buffer.hpp"
 
 # define BOOST_ASIO_INHERIT_TRACKED_HANDLER \
   : public ::custom_tracking::tracked_handler
@@ -15,6 +16,9 @@
 # define BOOST_ASIO_HANDLER_TRACKING_INIT \
   ::custom_tracking::init()
 
+# define BOOST_ASIO_HANDLER_LOCATION(args) \
+  (void)0
+
 # define BOOST_ASIO_HANDLER_CREATION(args) \
   ::custom_tracking::creation args
 
@@ -60,6 +64,29 @@ struct custom_tracking
   // Initialise the tracking system.
   static void init()
   {
+    trace_buffer::instance().start();
+  }
+
+  // Append a record to the calling thread's ring. Dropped if the ring is full.
+  static void write(trace_record::record_type type, std::uintmax_t a,
+      std::uintmax_t b, std::uintmax_t c, std::uintmax_t d,
+      const char* object = nullptr, const char* op = nullptr, int value = 0)
+  {
+    trace_ring& ring = trace_buffer::instance().ring();
+    if (trace_record* r = ring.prepare())
+    {
+      r->time = trace_buffer::now();
+      r->a = a;
+      r->b = b;
+      r->c = c;
+      r->d = d;
+      r->object = reinterpret_cast<std::uintptr_t>(object);
+      r->op = reinterpret_cast<std::uintptr_t>(op);
+      r->type = type;
+      r->thread = ring.thread();
+      r->value = value;
+      ring.commit();
+    }
   }
 
   // Record the creation of a tracked handler.
@@ -71,24 +98,32 @@ struct custom_tracking
     static std::atomic<std::uintmax_t> next_handler_id{1};
     h.handler_id_ = next_handler_id++;
 
-    // Copy the tree identifier forward from the current handler.
+    // Copy the tree identifier forward from the current handler, or start a
+    // new tree rooted at this handler.
+    std::uintmax_t parent = 0;
     if (*current_completion())
+    {
       h.tree_id_ = (*current_completion())->handler_.tree_id_;
+      parent = (*current_completion())->handler_.handler_id_;
+    }
+    else
+    {
+      h.tree_id_ = h.handler_id_;
+    }
 
     // Store various attributes of the operation to use in later output.
     h.object_type_ = object_type;
     h.native_handle_ = native_handle;
 
-    std::printf(
-        "Starting operation %s.%s for native_handle = %" PRIuMAX
-        ", handler = %" PRIuMAX ", tree = %" PRIuMAX "\n",
-        object_type, op_name, h.native_handle_, h.handler_id_, h.tree_id_);
+    write(trace_record::creation, h.handler_id_, h.tree_id_, parent,
+        h.native_handle_, object_type, op_name);
   }
 
   struct completion
   {
     explicit completion(const tracked_handler& h)
       : handler_(h),
+        invoked_(false),
         next_(*current_completion())
     {
       *current_completion() = this;
@@ -97,10 +132,15 @@ struct custom_tracking
     completion(const completion&) = delete;
     completion& operator=(const completion&) = delete;
 
-    // Destructor records only when an exception is thrown from the handler, or
-    // if the memory is being freed without the handler having been invoked.
+    // Destructor records only when an exception is thrown from the handler:
+    // the invocation_end record then carries value = 1. Freeing the memory
+    // without invoking the handler needs no record, as the decoder already
+    // reports handlers that were created but never entered.
     ~completion()
     {
+      if (invoked_)
+        write(trace_record::invocation_end,
+            handler_.handler_id_, handler_.tree_id_, 0, 0, nullptr, nullptr, 1);
       *current_completion() = next_;
     }
 
@@ -108,19 +148,24 @@ struct custom_tracking
     template <class... Args>
     void invocation_begin(Args&&... /*args*/)
     {
-      std::printf("Entering handler %" PRIuMAX " in tree %" PRIuMAX "\n",
-          handler_.handler_id_, handler_.tree_id_);
+      invoked_ = true;
+      write(trace_record::invocation_begin,
+          handler_.handler_id_, handler_.tree_id_, 0, 0);
     }
 
     // Record that handler invocation has ended.
     void invocation_end()
     {
-      std::printf("Leaving handler %" PRIuMAX " in tree %" PRIuMAX "\n",
-          handler_.handler_id_, handler_.tree_id_);
+      invoked_ = false;
+      write(trace_record::invocation_end,
+          handler_.handler_id_, handler_.tree_id_, 0, 0);
     }
 
     tracked_handler handler_;
 
+    // Set between invocation_begin and invocation_end.
+    bool invoked_;
+
     // Completions may nest. Here we stash a pointer to the outer completion.
     completion* next_;
   };
@@ -133,47 +178,40 @@ struct custom_tracking
 
   // Record an operation that is not directly associated with a handler.
   static void operation(boost::asio::execution_context& /*ctx*/,
-      const char* /*object_type*/, void* /*object*/,
-      std::uintmax_t /*native_handle*/, const char* /*op_name*/)
+      const char* object_type, void* /*object*/,
+      std::uintmax_t native_handle, const char* op_name)
   {
+    write(trace_record::operation, 0, 0, native_handle, 0, object_type, op_name);
   }
 
   // Record that a descriptor has been registered with the reactor.
-  static void reactor_registration(boost::asio::execution_context& context,
+  static void reactor_registration(boost::asio::execution_context& /*context*/,
       uintmax_t native_handle, uintmax_t registration)
   {
-    std::printf("Adding to reactor native_handle = %" PRIuMAX
-        ", registration = %" PRIuMAX "\n", native_handle, registration);
+    write(trace_record::reactor_registration, registration, 0, native_handle, 0);
   }
 
   // Record that a descriptor has been deregistered from the reactor.
-  static void reactor_deregistration(boost::asio::execution_context& context,
+  static void reactor_deregistration(boost::asio::execution_context& /*context*/,
       uintmax_t native_handle, uintmax_t registration)
   {
-    std::printf("Removing from reactor native_handle = %" PRIuMAX
-        ", registration = %" PRIuMAX "\n", native_handle, registration);
+    write(trace_record::reactor_deregistration, registration, 0, native_handle, 0);
   }
 
   // Record reactor-based readiness events associated with a descriptor.
-  static void reactor_events(boost::asio::execution_context& context,
+  static void reactor_events(boost::asio::execution_context& /*context*/,
       uintmax_t registration, unsigned events)
   {
-    std::printf(
-        "Reactor readiness for registration = %" PRIuMAX ", events =%s%s%s\n",
-        registration,
-        (events & BOOST_ASIO_HANDLER_REACTOR_READ_EVENT) ? " read" : "",
-        (events & BOOST_ASIO_HANDLER_REACTOR_WRITE_EVENT) ? " write" : "",
-        (events & BOOST_ASIO_HANDLER_REACTOR_ERROR_EVENT) ? " error" : "");
+    write(trace_record::reactor_events, registration, 0, 0, events);
   }
 
   // Record a reactor-based operation that is associated with a handler.
   static void reactor_operation(const tracked_handler& h,
       const char* op_name, const boost::system::error_code& ec)
   {
-    std::printf(
-        "Performed operation %s.%s for native_handle = %" PRIuMAX
-        ", ec = %s:%d\n", h.object_type_, op_name, h.native_handle_,
-        ec.category().name(), ec.value());
+    write(trace_record::reactor_operation, h.handler_id_,
+        reinterpret_cast<std::uintptr_t>(ec.category().name()),
+        h.native_handle_, ~std::uintmax_t(0), h.object_type_, op_name, ec.value());
   }
 
   // Record a reactor-based operation that is associated with a handler.
@@ -181,11 +219,9 @@ struct custom_tracking
       const char* op_name, const boost::system::error_code& ec,
       std::size_t bytes_transferred)
   {
-    std::printf(
-        "Performed operation %s.%s for native_handle = %" PRIuMAX
-        ", ec = %s:%d, n = %" PRIuMAX "\n", h.object_type_, op_name,
-        h.native_handle_, ec.category().name(), ec.value(),
-        static_cast<uintmax_t>(bytes_transferred));
+    write(trace_record::reactor_operation, h.handler_id_,
+        reinterpret_cast<std::uintptr_t>(ec.category().name()),
+        h.native_handle_, bytes_transferred, h.object_type_, op_name, ec.value());
   }
 };
 
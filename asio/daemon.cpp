@@ -2,23 +2,37 @@
 #include <boost/asio/ip/udp.hpp>
 #include <boost/asio/signal_set.hpp>
 #include <array>
+#include <cstdlib>
+#include <cstring>
 #include <ctime>
 #include <iostream>
+#include <list>
+#include <vector>
+#include <fcntl.h>
 #include <syslog.h>
 #include <unistd.h>
+#include "thread_pool/io_context_per_core.hpp"
 
 using boost::asio::ip::udp;
 //-------------------------------------------
 //udp服务器
+//reuse为true时每个线程一个server，各自用SO_REUSEPORT绑定同一端口
 class udp_daytime_server
 {
 public:
-  udp_daytime_server(boost::asio::io_context& io_context)
-    : socket_(io_context, {udp::v4(), 13})
+  udp_daytime_server(boost::asio::io_context& io_context, bool reuse = false)
+    : socket_(io_context),
+      packets_(0)
   {
+    open_udp_socket(socket_, {udp::v4(), 13}, reuse);
     receive();
   }
 
+  std::size_t packets() const  //已回复的请求数，停止后读取
+  {
+    return packets_;
+  }
+
 private:
   void receive()
   {
@@ -35,6 +49,7 @@ private:
             boost::system::error_code ignored_ec;
             socket_.send_to(boost::asio::buffer(message),
                 remote_endpoint_, 0, ignored_ec);    //发送数据
+            ++packets_;
           }
 
           receive();   //继续接收
@@ -44,25 +59,40 @@ private:
   udp::socket socket_;
   udp::endpoint remote_endpoint_;
   std::array<char, 1> recv_buffer_;
+  std::size_t packets_;
 };
 
-int main()
+int main(int argc, char* argv[])
 {
   try
   {
-    boost::asio::io_context io_context;
-    udp_daytime_server server(io_context);//先启动服务器
+    std::size_t threads = 1;
+    int pin = -1;
+    for (int arg = 1; arg + 1 < argc; arg += 2)
+    {
+      if (std::strcmp(argv[arg], "-t") == 0)  //线程数，0表示每个核一个
+        threads = std::strtoul(argv[arg + 1], nullptr, 10);
+      else if (std::strcmp(argv[arg], "-p") == 0)  //是否绑定CPU，默认多线程时绑定
+        pin = std::atoi(argv[arg + 1]);
+    }
+
+    //每个线程一个io_context和一个socket，线程之间不共享任何状态
+    io_context_per_core contexts(threads, pin < 0 ? threads != 1 : pin != 0);
+    std::list<udp_daytime_server> servers;
+    for (std::size_t i = 0; i < contexts.size(); ++i)
+      servers.emplace_back(contexts.context(i), contexts.size() != 1);//先启动服务器
 
-    boost::asio::signal_set signals(io_context, SIGINT, SIGTERM);//注册信号
+    boost::asio::signal_set signals(contexts.context(0), SIGINT, SIGTERM);//注册信号
     signals.async_wait(
         [&](boost::system::error_code /*ec*/, int /*signo*/)
         {
-          io_context.stop();
+          contexts.stop();
         });  //异步等待信号，关闭服务器
 
-    io_context.notify_fork(boost::asio::io_context::fork_prepare);//通知io_context，我将成为守护进程
+    for (boost::asio::io_context* c: contexts.contexts())
+      c->notify_fork(boost::asio::io_context::fork_prepare);//通知io_context，我将成为守护进程
 
-    if (pid_t pid = fork())创建进程
+    if (pid_t pid = fork())//创建进程
     {
       if (pid > 0)
       {
@@ -117,11 +147,17 @@ int main()
       return 1;
     }
 
-    io_context.notify_fork(boost::asio::io_context::fork_child);//通知io_context我们已经创建好了守护进程
+    for (boost::asio::io_context* c: contexts.contexts())
+      c->notify_fork(boost::asio::io_context::fork_child);//通知io_context我们已经创建好了守护进程
 
     syslog(LOG_INFO | LOG_USER, "Daemon started");
-    io_context.run();                                    //启动它
+    contexts.run();                                      //启动它，线程在fork之后才创建
     syslog(LOG_INFO | LOG_USER, "Daemon stopped");
+
+    std::vector<std::size_t> packets;                   //每个线程处理的请求数写到日志文件
+    for (const udp_daytime_server& s: servers)
+      packets.push_back(s.packets());
+    print_distribution(std::cout, "packets", packets);
   }
   catch (std::exception& e)
   {
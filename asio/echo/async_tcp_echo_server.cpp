@@ -1,101 +1,56 @@
+#include <csignal>
 #include <cstdlib>
+#include <cstring>
 #include <iostream>
-#include <memory>
-#include <utility>
+#include <list>
+#include <vector>
 #include <boost/asio.hpp>
-
-using boost::asio::ip::tcp;
-//-------------------------------------------
-//已连接对象
-class session
-  : public std::enable_shared_from_this<session>
-{
-public:
-  session(tcp::socket socket)
-    : socket_(std::move(socket))
-  {
-  }
-
-  void start()
-  {
-    do_read();
-  }
-
-private:
-  void do_read()  //读
-  {
-    auto self(shared_from_this());
-    socket_.async_read_some(boost::asio::buffer(data_, max_length),
-        [this, self](boost::system::error_code ec, std::size_t length)
-        {
-          if (!ec)
-          {
-            do_write(length);
-          }
-        });
-  }
-
-  void do_write(std::size_t length)  //写
-  {
-    auto self(shared_from_this());
-    boost::asio::async_write(socket_, boost::asio::buffer(data_, length),
-        [this, self](boost::system::error_code ec, std::size_t /*length*/)
-        {
-          if (!ec)
-          {
-            do_read();
-          }
-        });
-  }
-
-  tcp::socket socket_;
-  enum { max_length = 1024 };
-  char data_[max_length];
-};
-//---------------------------------------
-//监听服务器
-class server
-{
-public:
-  server(boost::asio::io_context& io_context, short port)
-    : acceptor_(io_context, tcp::endpoint(tcp::v4(), port))
-  {
-    do_accept();
-  }
-
-private:
-  void do_accept()
-  {
-    acceptor_.async_accept(
-        [this](boost::system::error_code ec, tcp::socket socket)
-        {
-          if (!ec)
-          {
-            std::make_shared<session>(std::move(socket))->start();//创建连接对象
-          }
-
-          do_accept();
-        });
-  }
-
-  tcp::acceptor acceptor_;
-};
+#include "async_tcp_echo_server.hpp"
 
 int main(int argc, char* argv[])
 {
   try
   {
-    if (argc != 2)
+    std::size_t threads = 1;
+    bool duplex = false;
+    int arg = 1;
+    for (; arg + 1 < argc && argv[arg][0] == '-'; arg += 2)
+    {
+      if (std::strcmp(argv[arg], "-t") == 0)  //线程数，0表示每个核一个
+        threads = std::strtoul(argv[arg + 1], nullptr, 10);
+      else if (std::strcmp(argv[arg], "-m") == 0 && std::strcmp(argv[arg + 1], "duplex") == 0)
+        duplex = true;  //全双工连接
+      else if (std::strcmp(argv[arg], "-m") == 0 && std::strcmp(argv[arg + 1], "alternate") == 0)
+        duplex = false;
+      else
+        break;
+    }
+    if (arg + 1 != argc)
     {
-      std::cerr << "Usage: async_tcp_echo_server <port>\n";
+      std::cerr << "Usage: async_tcp_echo_server [-t <threads>] [-m alternate|duplex] <port>\n";
       return 1;
     }
 
-    boost::asio::io_context io_context;
+    //多线程时每个线程一个io_context并绑定CPU，各自用SO_REUSEPORT监听同一端口
+    bool per_core = threads != 1;
+    io_context_per_core contexts(threads, per_core);
+    std::list<echo_server> servers;
+    for (std::size_t i = 0; i < contexts.size(); ++i)
+      servers.emplace_back(contexts.context(i), std::atoi(argv[arg]), per_core, duplex);
+
+    boost::asio::signal_set signals(contexts.context(0), SIGINT, SIGTERM);  //退出时打印连接分布
+    signals.async_wait(
+        [&contexts](boost::system::error_code /*ec*/, int /*signo*/)
+        {
+          contexts.stop();
+        });
 
-    server s(io_context, std::atoi(argv[1]));
+    contexts.run();
 
-    io_context.run();
+    std::vector<std::size_t> accepted;
+    for (const echo_server& s: servers)
+      accepted.push_back(s.accepted());
+    print_connection_distribution(std::cout, accepted);
   }
   catch (std::exception& e)
   {
@@ -0,0 +1,231 @@
+//异步tcp echo服务器：读写交替的连接、全双工连接和监听服务器
+//async_tcp_echo_server.cpp和echo_bench.cpp共用
+#ifndef ASYNC_TCP_ECHO_SERVER_HPP
+#define ASYNC_TCP_ECHO_SERVER_HPP
+
+#include <cstddef>
+#include <memory>
+#include <utility>
+#include <boost/asio.hpp>
+#include "../allocation/session_pool.hpp"
+#include "../allocation/thread_cache.hpp"
+#include "../buffers/adaptive_buffer.hpp"
+#include "../buffers/byte_ring.hpp"
+#include "../thread_pool/io_context_per_core.hpp"
+
+//-------------------------------------------
+//已连接对象
+class echo_session
+  : public std::enable_shared_from_this<echo_session>
+{
+public:
+  typedef boost::asio::ip::tcp tcp;
+
+  echo_session(tcp::socket socket)
+    : socket_(std::move(socket))
+  {
+  }
+
+  void start()
+  {
+    socket_.non_blocking(true);  //可读后用同步read_some取数据，不会阻塞
+    do_read();
+  }
+
+  void reset(tcp::socket socket)  //对象池复用：换上新连接
+  {
+    socket_ = std::move(socket);
+  }
+
+  void recycle()  //连接结束，放回对象池之前关闭socket、归还缓冲区
+  {
+    boost::system::error_code ignored;
+    socket_.close(ignored);
+    buffer_.reset();
+  }
+
+private:
+  void do_read()  //先读一次，没有数据就归还缓冲区，等待可读
+  {
+    boost::system::error_code ec;
+    std::size_t length = socket_.read_some(buffer_.prepare(), ec);
+    if (!ec)
+    {
+      buffer_.commit(length);
+      do_write(length);
+      return;
+    }
+    buffer_.release();
+    if (ec != boost::asio::error::would_block)
+      return;
+
+    auto self(shared_from_this());
+    socket_.async_wait(tcp::socket::wait_read,
+        [this, self](boost::system::error_code ec)
+        {
+          if (!ec)
+          {
+            do_read();
+          }
+        });
+  }
+
+  void do_write(std::size_t length)  //写
+  {
+    auto self(shared_from_this());
+    boost::asio::async_write(socket_, boost::asio::buffer(buffer_.data(), length),
+        [this, self](boost::system::error_code ec, std::size_t /*length*/)
+        {
+          if (!ec)
+          {
+            do_read();
+          }
+        });
+  }
+
+  thread_cached_io<tcp::socket> socket_;  //异步操作的处理函数使用线程缓存
+  adaptive_read_buffer buffer_;  //只在读到数据到写完之间持有
+};
+//-------------------------------------------
+//全双工连接：读写各自独立挂起，读到的数据进环形缓冲区，写出一部分就腾出一部分
+//写未完成时继续读；环满时暂停读，等写腾出空间后恢复
+class duplex_echo_session
+  : public std::enable_shared_from_this<duplex_echo_session>
+{
+public:
+  typedef boost::asio::ip::tcp tcp;
+
+  enum { ring_size = 64 * 1024 };
+
+  duplex_echo_session(tcp::socket socket)
+    : socket_(std::move(socket)),
+      ring_(ring_size),
+      reading_(false),
+      writing_(false),
+      read_closed_(false)
+  {
+  }
+
+  void start()
+  {
+    do_read();
+  }
+
+  void reset(tcp::socket socket)  //对象池复用：换上新连接
+  {
+    socket_ = std::move(socket);
+  }
+
+  void recycle()  //连接结束，放回对象池之前关闭socket、清空环
+  {
+    boost::system::error_code ignored;
+    socket_.close(ignored);
+    ring_.clear();
+    reading_ = false;
+    writing_ = false;
+    read_closed_ = false;
+  }
+
+private:
+  void do_read()  //读
+  {
+    if (reading_ || read_closed_ || ring_.full())
+      return;  //环满时暂停，由do_write恢复
+
+    reading_ = true;
+    auto self(shared_from_this());
+    socket_.async_read_some(ring_.prepare(),
+        [this, self](boost::system::error_code ec, std::size_t length)
+        {
+          reading_ = false;
+          if (ec)
+          {
+            read_closed_ = true;  //对端关闭，写完剩余数据后连接结束
+            return;
+          }
+          ring_.commit(length);
+          do_write();
+          do_read();
+        });
+  }
+
+  void do_write()  //写
+  {
+    if (writing_ || ring_.empty())
+      return;
+
+    writing_ = true;
+    auto self(shared_from_this());
+    socket_.async_write_some(ring_.data(),
+        [this, self](boost::system::error_code ec, std::size_t length)
+        {
+          writing_ = false;
+          if (ec)
+          {
+            boost::system::error_code ignored;
+            socket_.close(ignored);  //取消挂起的读
+            return;
+          }
+          ring_.consume(length);
+          do_write();
+          do_read();
+        });
+  }
+
+  thread_cached_io<tcp::socket> socket_;  //异步操作的处理函数使用线程缓存
+  byte_ring ring_;
+  bool reading_;
+  bool writing_;
+  bool read_closed_;
+};
+//---------------------------------------
+//监听服务器
+class echo_server
+{
+public:
+  typedef boost::asio::ip::tcp tcp;
+
+  //reuse为true时各线程的server监听同一端口，由内核分配连接
+  //duplex为true时使用全双工连接，否则读写交替
+  echo_server(boost::asio::io_context& io_context, short port, bool reuse = false,
+      bool duplex = false)
+    : acceptor_(io_context),
+      accepted_(0),
+      duplex_(duplex)
+  {
+    open_acceptor(acceptor_, tcp::endpoint(tcp::v4(), port), reuse);
+    do_accept();
+  }
+
+  std::size_t accepted() const  //接受的连接数
+  {
+    return accepted_;
+  }
+
+private:
+  void do_accept()
+  {
+    acceptor_.async_accept(
+        [this](boost::system::error_code ec, tcp::socket socket)
+        {
+          if (!ec)
+          {
+            ++accepted_;
+            if (duplex_)
+              duplex_sessions_.acquire(std::move(socket))->start();
+            else
+              sessions_.acquire(std::move(socket))->start();//从对象池取连接对象
+          }
+
+          do_accept();
+        });
+  }
+
+  thread_cached_io<tcp::acceptor> acceptor_;
+  std::size_t accepted_;
+  bool duplex_;
+  session_pool<echo_session> sessions_;
+  session_pool<duplex_echo_session> duplex_sessions_;
+};
+
+#endif // ASYNC_TCP_ECHO_SERVER_HPP
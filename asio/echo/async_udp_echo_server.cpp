@@ -6,18 +6,50 @@
 //boost::asio::buffer(data_, max_length), sender_endpoint_,[this](boost::system::error_code ec, std::size_t bytes_recvd)
 //socket_.async_send_to(boost::asio::buffer(data_, length), sender_endpoint_,[this](boost::system::error_code /*ec*/, std::size_t /*bytes_sent*/)
 //io_context.run();
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <cstdint>
 #include <cstdlib>
+#include <cstring>
 #include <iostream>
+#include <list>
+#include <memory>
+#include <vector>
 #include <boost/asio.hpp>
+#include "../thread_pool/io_context_per_core.hpp"
+#include "../udp/packet_batch.hpp"
+#include "../udp/udp_offload.hpp"
 
 using boost::asio::ip::udp;
+//-------------------------------------------
+//每个分片一个计数，只有所在线程写，其他线程可以随时读
+class packet_counter
+{
+public:
+  void add(std::uint64_t n)
+  {
+    count_.store(count_.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+  }
+
+  std::uint64_t load() const
+  {
+    return count_.load(std::memory_order_relaxed);
+  }
+
+private:
+  std::atomic<std::uint64_t> count_{0};
+};
+//-------------------------------------------
 //udp服务器
+//reuse为true时各线程的server绑定同一端口，由内核按来源地址分配数据报
 class server
 {
 public:
-  server(boost::asio::io_context& io_context, short port)
-    : socket_(io_context, udp::endpoint(udp::v4(), port))
+  server(boost::asio::io_context& io_context, short port, bool reuse = false)
+    : socket_(io_context)
   {
+    open_udp_socket(socket_, udp::endpoint(udp::v4(), port), reuse);
     do_receive();
   }
 
@@ -29,6 +61,7 @@ public:
         {
           if (!ec && bytes_recvd > 0)
           {
+            packets_.add(1);
             do_send(bytes_recvd);
           }
           else
@@ -38,6 +71,11 @@ public:
         });
   }
 
+  std::uint64_t packets() const  //已回复的数据报数
+  {
+    return packets_.load();
+  }
+
   void do_send(std::size_t length) //写
   {
     socket_.async_send_to(
@@ -53,23 +91,271 @@ private:
   udp::endpoint sender_endpoint_;
   enum { max_length = 1024 };
   char data_[max_length];
+  packet_counter packets_;
+};
+//-------------------------------------------
+//批量模式：等待可读后用recvmmsg一次收最多batch个数据报，再用sendmmsg一次全部回复
+//发送缓冲区满时不阻塞io线程，等待可写后发完这一批再继续收
+class batch_server
+{
+public:
+  enum { max_length = 1024 };
+
+  batch_server(boost::asio::io_context& io_context, short port, bool reuse,
+      std::size_t batch)
+    : socket_(io_context),
+      batch_(batch, max_length)
+  {
+    open_udp_socket(socket_, udp::endpoint(udp::v4(), port), reuse);
+    socket_.non_blocking(true);
+    do_wait();
+  }
+
+  std::uint64_t packets() const  //已回复的数据报数
+  {
+    return packets_.load();
+  }
+
+private:
+  void do_wait()  //等待可读
+  {
+    socket_.async_wait(udp::socket::wait_read,
+        [this](boost::system::error_code ec)
+        {
+          if (!ec)
+            drain();
+        });
+  }
+
+  void drain()  //收空接收缓冲区，每批原地回复
+  {
+    boost::system::error_code ec;
+    for (;;)
+    {
+      std::size_t n = batch_.receive(socket_, ec);
+      if (n == 0)
+        break;
+      if (!reply(0, n))
+        return;
+      if (n < batch_.capacity())
+        break;
+    }
+    do_wait();
+  }
+
+  //回复第first到count-1个数据报；发送缓冲区满时等待可写后继续，返回false
+  bool reply(std::size_t first, std::size_t count)
+  {
+    boost::system::error_code ec;
+    std::size_t sent = batch_.send(socket_, first, count, ec);
+    packets_.add(sent);
+    if (ec != boost::asio::error::would_block)
+      return true;   //其他错误丢弃这一批的剩余部分
+    do_wait_write(first + sent, count);
+    return false;
+  }
+
+  void do_wait_write(std::size_t first, std::size_t count)
+  {
+    socket_.async_wait(udp::socket::wait_write,
+        [this, first, count](boost::system::error_code ec)
+        {
+          if (!ec && reply(first, count))
+            drain();
+        });
+  }
+
+  udp::socket socket_;
+  packet_batch batch_;
+  packet_counter packets_;
 };
+//-------------------------------------------
+//卸载模式：用GRO收同一发送方合并后的大包，按段计数，再用GSO按同样的段大小一次发回
+//发送方没有用GSO时内核不合并，每次收到一个数据报，退化为逐个收发
+class offload_server
+{
+public:
+  offload_server(boost::asio::io_context& io_context, short port, bool reuse)
+    : socket_(io_context)
+  {
+    open_udp_socket(socket_, udp::endpoint(udp::v4(), port), reuse);
+    if (!segment_receiver::enable(socket_))
+      std::cerr << "UDP_GRO not supported, receiving one datagram at a time\n";
+    socket_.non_blocking(true);   //发送缓冲区满时不阻塞io线程
+    do_wait();
+  }
+
+  std::uint64_t packets() const  //已回复的数据报数
+  {
+    return packets_.load();
+  }
+
+private:
+  void do_wait()  //等待可读
+  {
+    socket_.async_wait(udp::socket::wait_read,
+        [this](boost::system::error_code ec)
+        {
+          if (!ec)
+            drain();
+        });
+  }
+
+  void drain()  //收空接收缓冲区，每个大包原样按段发回
+  {
+    boost::system::error_code ec;
+    for (;;)
+    {
+      receiver_.receive(socket_, ec);
+      if (ec)   //would_block或其他错误都由do_wait()重新等待
+        break;
+      if (!reply(0))
+        return;
+    }
+    do_wait();
+  }
+
+  //从第first段开始发回收到的大包；发送缓冲区满时等待可写后继续，返回false
+  bool reply(std::size_t first)
+  {
+    std::size_t segment_size = receiver_.segment_size() != 0 ? receiver_.segment_size() : 1;
+    std::size_t offset = first * segment_size;
+    boost::system::error_code ec;
+    std::size_t sent = sender_.send(socket_, receiver_.sender(), receiver_.data() + offset,
+        receiver_.size() - offset, segment_size, ec);
+    packets_.add(sent);
+    if (ec != boost::asio::error::would_block)
+      return true;   //其他错误丢弃剩余的段
+    do_wait_write(first + sent);
+    return false;
+  }
+
+  void do_wait_write(std::size_t first)
+  {
+    socket_.async_wait(udp::socket::wait_write,
+        [this, first](boost::system::error_code ec)
+        {
+          if (!ec && reply(first))
+            drain();
+        });
+  }
+
+  udp::socket socket_;
+  segment_receiver receiver_;
+  segment_sender sender_;
+  packet_counter packets_;
+};
+//-------------------------------------------
+//定期打印所有分片每秒处理的数据报数
+template <typename Server>
+class pps_reporter
+{
+public:
+  pps_reporter(boost::asio::io_context& io_context, const std::list<Server>& servers,
+      std::size_t seconds)
+    : timer_(io_context),
+      servers_(servers),
+      interval_(seconds),
+      last_(0)
+  {
+    do_wait();
+  }
+
+private:
+  void do_wait()
+  {
+    timer_.expires_after(interval_);
+    timer_.async_wait(
+        [this](boost::system::error_code ec)
+        {
+          if (ec)
+            return;
+          std::uint64_t packets = 0;
+          for (const Server& s: servers_)
+            packets += s.packets();
+          std::cout << "packets=" << packets
+            << " pps=" << (packets - last_) / interval_.count() << std::endl;
+          last_ = packets;
+          do_wait();
+        });
+  }
+
+  boost::asio::steady_timer timer_;
+  const std::list<Server>& servers_;
+  std::chrono::seconds interval_;
+  std::uint64_t last_;
+};
+//-------------------------------------------
+//每个io_context一个server，运行到收到信号，然后打印每个分片的数据报数
+template <typename Server, typename... Args>
+void run_servers(io_context_per_core& contexts, short port, std::size_t report_seconds,
+    Args... args)
+{
+  bool reuse = contexts.size() != 1;
+  std::list<Server> servers;
+  for (std::size_t i = 0; i < contexts.size(); ++i)
+    servers.emplace_back(contexts.context(i), port, reuse, args...);
+
+  std::unique_ptr<pps_reporter<Server> > reporter;
+  if (report_seconds != 0)
+    reporter.reset(new pps_reporter<Server>(contexts.context(0), servers, report_seconds));
+
+  boost::asio::signal_set signals(contexts.context(0), SIGINT, SIGTERM);  //退出时打印分布
+  signals.async_wait(
+      [&contexts](boost::system::error_code /*ec*/, int /*signo*/)
+      {
+        contexts.stop();
+      });
+
+  contexts.run();
+
+  std::vector<std::size_t> packets;
+  for (const Server& s: servers)
+    packets.push_back(s.packets());
+  print_distribution(std::cout, "packets", packets);
+}
 
 int main(int argc, char* argv[])
 {
   try
   {
-    if (argc != 2)
+    std::size_t batch = 0;
+    bool offload = false;
+    std::size_t report_seconds = 0;
+    std::size_t threads = 1;
+    int pin = -1;
+    int arg = 1;
+    for (; arg + 1 < argc && argv[arg][0] == '-'; arg += 2)
+    {
+      if (std::strcmp(argv[arg], "-b") == 0)  //批量大小，0为逐个收发
+        batch = std::strtoul(argv[arg + 1], nullptr, 10);
+      else if (std::strcmp(argv[arg], "-g") == 0)  //1为GRO接收、GSO回复
+        offload = std::atoi(argv[arg + 1]) != 0;
+      else if (std::strcmp(argv[arg], "-s") == 0)  //打印pps的间隔(秒)
+        report_seconds = std::strtoul(argv[arg + 1], nullptr, 10);
+      else if (std::strcmp(argv[arg], "-t") == 0)  //线程数，0表示每个核一个
+        threads = std::strtoul(argv[arg + 1], nullptr, 10);
+      else if (std::strcmp(argv[arg], "-p") == 0)  //是否绑定CPU，默认多线程时绑定
+        pin = std::atoi(argv[arg + 1]);
+      else
+        break;
+    }
+    if (arg + 1 != argc)
     {
-      std::cerr << "Usage: async_udp_echo_server <port>\n";
+      std::cerr << "Usage: async_udp_echo_server [-b <batch>] [-g 0|1] [-s <report_seconds>]"
+        " [-t <threads>] [-p 0|1] <port>\n";
       return 1;
     }
 
-    boost::asio::io_context io_context;
-
-    server s(io_context, std::atoi(argv[1]));
-
-    io_context.run();
+    //多线程时每个线程一个io_context和一个socket，各自用SO_REUSEPORT绑定同一端口
+    io_context_per_core contexts(threads, pin < 0 ? threads != 1 : pin != 0);
+    short port = std::atoi(argv[arg]);
+    if (offload)
+      run_servers<offload_server>(contexts, port, report_seconds);
+    else if (batch != 0)
+      run_servers<batch_server>(contexts, port, report_seconds, batch);
+    else
+      run_servers<server>(contexts, port, report_seconds);
   }
   catch (std::exception& e)
   {
@@ -0,0 +1,300 @@
+//echo服务器对比测试：在本进程内依次启动各个echo服务器，用环回连接测吞吐量、延迟和每次往返的堆分配次数
+//echo_bench [-c <connections>] [-m <message_size>] [-d <pipeline_depth>] [-n <round_trips>] [-w <warmup>] [-p <port>]
+//每个服务器输出一行 key=value，便于脚本解析和对比
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <new>
+#include <thread>
+#include <vector>
+#include <boost/asio.hpp>
+#include "../allocation/server.hpp"
+#include "async_tcp_echo_server.hpp"
+
+//----------------------------------------------------------------------
+//替换全局operator new：只统计服务器线程的分配
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"  //malloc/free配对是有意的
+#endif
+static std::atomic<std::uint64_t> server_allocations(0);
+static thread_local bool count_allocations = false;
+
+void* operator new(std::size_t size)
+{
+  if (count_allocations)
+    server_allocations.fetch_add(1, std::memory_order_relaxed);
+  if (void* p = std::malloc(size ? size : 1))
+    return p;
+  throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size)
+{
+  return ::operator new(size);
+}
+
+void operator delete(void* p) noexcept
+{
+  std::free(p);
+}
+
+void operator delete[](void* p) noexcept
+{
+  std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept
+{
+  std::free(p);
+}
+
+void operator delete[](void* p, std::size_t) noexcept
+{
+  std::free(p);
+}
+
+//----------------------------------------------------------------------
+//全双工模式的async_tcp_echo_server
+struct duplex_echo_server : echo_server
+{
+  duplex_echo_server(boost::asio::io_context& io_context, short port)
+    : echo_server(io_context, port, false, true)
+  {
+  }
+};
+
+using boost::asio::ip::tcp;
+
+//----------------------------------------------------------------------
+//测试参数
+struct bench_options
+{
+  std::size_t connections = 8;
+  std::size_t message_size = 64;
+  std::size_t depth = 1;          //每个连接同时在途的消息数
+  std::size_t round_trips = 10000; //每个连接的往返次数
+  std::size_t warmup = 1000;      //预热往返次数，不计入结果
+  unsigned short port = 9500;
+};
+
+//----------------------------------------------------------------------
+//测试连接：保持depth条消息在途，每收回一条记录延迟再发一条
+class bench_connection
+{
+public:
+  bench_connection(boost::asio::io_context& io_context,
+      const bench_options& options, std::vector<std::uint64_t>& latencies)
+    : socket_(io_context),
+      size_(options.message_size),
+      depth_(options.depth),
+      out_(options.message_size * options.depth, 'x'),
+      in_(options.message_size),
+      sent_times_(options.depth),
+      latencies_(latencies)
+  {
+  }
+
+  void connect(const tcp::endpoint& endpoint)
+  {
+    socket_.connect(endpoint);
+    socket_.set_option(tcp::no_delay(true));
+  }
+
+  void start(std::size_t rounds)  //跑完rounds次往返后不再挂起任何操作
+  {
+    rounds_ = rounds;
+    sent_ = 0;
+    received_ = 0;
+    head_ = 0;
+    in_flight_ = 0;
+    pending_ = 0;
+    if (rounds_ == 0)
+      return;
+    send(std::min(depth_, rounds_));
+    do_read();
+  }
+
+private:
+  typedef std::chrono::steady_clock clock;
+
+  void send(std::size_t n)
+  {
+    sent_ += n;
+    pending_ += n;
+    if (!writing_)
+      do_write();
+  }
+
+  void do_write()  //排队的消息合成一次写
+  {
+    std::size_t n = pending_;
+    pending_ = 0;
+    writing_ = true;
+    clock::time_point now = clock::now();
+    for (std::size_t i = 0; i < n; ++i)
+      sent_times_[(head_ + in_flight_++) % depth_] = now;
+
+    boost::asio::async_write(socket_, boost::asio::buffer(out_.data(), n * size_),
+        [this](boost::system::error_code ec, std::size_t /*length*/)
+        {
+          writing_ = false;
+          if (!ec && pending_ != 0)
+            do_write();
+        });
+  }
+
+  void do_read()
+  {
+    boost::asio::async_read(socket_, boost::asio::buffer(in_),
+        [this](boost::system::error_code ec, std::size_t /*length*/)
+        {
+          if (ec)
+            return;
+          clock::duration d = clock::now() - sent_times_[head_];
+          latencies_.push_back(
+              std::chrono::duration_cast<std::chrono::nanoseconds>(d).count());
+          head_ = (head_ + 1) % depth_;
+          --in_flight_;
+
+          if (sent_ < rounds_)
+            send(1);
+          if (++received_ < rounds_)
+            do_read();
+        });
+  }
+
+  tcp::socket socket_;
+  std::size_t size_;
+  std::size_t depth_;
+  std::vector<char> out_;
+  std::vector<char> in_;
+  std::vector<clock::time_point> sent_times_;  //在途消息的发送时间，环形
+  std::vector<std::uint64_t>& latencies_;
+  std::size_t rounds_ = 0;
+  std::size_t sent_ = 0;
+  std::size_t received_ = 0;
+  std::size_t head_ = 0;
+  std::size_t in_flight_ = 0;
+  std::size_t pending_ = 0;   //等待写出的消息数
+  bool writing_ = false;
+};
+
+//----------------------------------------------------------------------
+//启动一个服务器，先预热再正式测试，输出一行结果
+template <typename Server>
+void run_variant(const char* name, const bench_options& options)
+{
+  boost::asio::io_context server_io;
+  std::unique_ptr<Server> server(new Server(server_io, options.port));
+  std::thread server_thread(
+      [&server_io]()
+      {
+        count_allocations = true;
+        server_io.run();
+      });
+
+  boost::asio::io_context client_io;
+  std::vector<std::uint64_t> latencies;
+  latencies.reserve(options.connections * std::max(options.round_trips, options.warmup));
+  std::vector<std::unique_ptr<bench_connection> > connections;
+  tcp::endpoint endpoint(boost::asio::ip::address_v4::loopback(), options.port);
+  for (std::size_t i = 0; i < options.connections; ++i)
+  {
+    connections.emplace_back(new bench_connection(client_io, options, latencies));
+    connections.back()->connect(endpoint);
+  }
+
+  //预热：让各个缓存和内存池进入稳定状态
+  for (auto& c: connections)
+    c->start(options.warmup);
+  client_io.run();
+  client_io.restart();
+  latencies.clear();
+
+  std::uint64_t allocations = server_allocations.load(std::memory_order_relaxed);
+  auto start = std::chrono::steady_clock::now();
+  for (auto& c: connections)
+    c->start(options.round_trips);
+  client_io.run();
+  double seconds = std::chrono::duration<double>(
+      std::chrono::steady_clock::now() - start).count();
+  allocations = server_allocations.load(std::memory_order_relaxed) - allocations;
+
+  server_io.stop();
+  server_thread.join();
+
+  std::sort(latencies.begin(), latencies.end());
+  auto percentile_us = [&latencies](double q)
+  {
+    if (latencies.empty())
+      return 0.0;
+    std::size_t i = static_cast<std::size_t>(q * (latencies.size() - 1));
+    return latencies[i] / 1000.0;
+  };
+
+  double round_trips = static_cast<double>(latencies.size());
+  std::cout << "variant=" << name
+    << " connections=" << options.connections
+    << " message_size=" << options.message_size
+    << " depth=" << options.depth
+    << " round_trips=" << latencies.size()
+    << " seconds=" << seconds
+    << " round_trips_per_sec=" << round_trips / seconds
+    << " MB_per_sec=" << round_trips * options.message_size * 2 / seconds / 1e6
+    << " p50_us=" << percentile_us(0.50)
+    << " p99_us=" << percentile_us(0.99)
+    << " p999_us=" << percentile_us(0.999)
+    << " allocations_per_round_trip="
+    << (round_trips != 0 ? allocations / round_trips : 0.0) << "\n";
+}
+
+//----------------------------------------------------------------------
+
+int main(int argc, char* argv[])
+{
+  try
+  {
+    bench_options options;
+    int arg = 1;
+    for (; arg + 1 < argc && argv[arg][0] == '-'; arg += 2)
+    {
+      std::size_t value = std::strtoul(argv[arg + 1], nullptr, 10);
+      if (std::strcmp(argv[arg], "-c") == 0)  //连接数
+        options.connections = std::max<std::size_t>(1, value);
+      else if (std::strcmp(argv[arg], "-m") == 0)  //消息字节数
+        options.message_size = std::max<std::size_t>(1, value);
+      else if (std::strcmp(argv[arg], "-d") == 0)  //流水线深度
+        options.depth = std::max<std::size_t>(1, value);
+      else if (std::strcmp(argv[arg], "-n") == 0)  //每个连接的往返次数
+        options.round_trips = value;
+      else if (std::strcmp(argv[arg], "-w") == 0)  //预热往返次数
+        options.warmup = value;
+      else if (std::strcmp(argv[arg], "-p") == 0)  //监听端口
+        options.port = static_cast<unsigned short>(value);
+      else
+        break;
+    }
+
+    if (arg != argc)
+    {
+      std::cerr << "Usage: echo_bench [-c <connections>] [-m <message_size>] [-d <pipeline_depth>]"
+        " [-n <round_trips>] [-w <warmup>] [-p <port>]\n";
+      return 1;
+    }
+
+    run_variant<echo_server>("async_tcp_echo_server", options);
+    run_variant<duplex_echo_server>("async_tcp_echo_server_duplex", options);
+    run_variant<arena_server>("allocation_server", options);
+  }
+  catch (std::exception& e)
+  {
+    std::cerr << "Exception: " << e.what() << "\n";
+  }
+
+  return 0;
+}
@@ -0,0 +1,495 @@
+//echo服务器压力测试：在几个线程上开成千上万个异步连接，tcp和udp echo服务器都能测
+//开环(-r 每秒总请求数)：按固定时间表发送，延迟从计划发送时间算起，服务器卡顿期间本该发出的请求
+//  也算上等待时间，不会因为客户端跟着变慢而漏记(协调遗漏修正)
+//闭环(-d 流水线深度)：每个连接保持depth个请求在途，收到一个再发一个
+//请求开头8字节是发送时间戳，echo回来后算延迟；结果输出一行 key=value
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <thread>
+#include <vector>
+#include <boost/asio.hpp>
+#include "latency_histogram.hpp"
+
+using boost::asio::ip::tcp;
+using boost::asio::ip::udp;
+typedef std::chrono::steady_clock load_clock;
+
+//----------------------------------------------------------------------
+//测试参数
+struct load_options
+{
+  bool udp = false;
+  std::size_t connections = 100;
+  std::size_t threads = 1;
+  std::size_t message_size = 64;  //至少8字节
+  double rate = 0;                //每秒总请求数，0表示闭环
+  std::size_t depth = 1;          //闭环时每个连接的在途请求数
+  std::size_t duration = 10;      //发送持续秒数
+  std::size_t drain_ms = 1000;    //停止发送后等待回复的时间，udp丢的包不会再来
+};
+
+//----------------------------------------------------------------------
+//每个线程一份，线程结束后汇总
+struct load_stats
+{
+  latency_histogram latency;  //纳秒
+  std::uint64_t sent = 0;
+  std::uint64_t received = 0;
+  std::uint64_t errors = 0;   //连接失败或中途断开
+};
+
+//----------------------------------------------------------------------
+//连接的公共部分：发送时间表、延迟记录、结束条件
+class load_connection
+{
+public:
+  load_connection(boost::asio::io_context& io_context,
+      const load_options& options, load_stats& stats)
+    : timer_(io_context),
+      options_(options),
+      stats_(stats),
+      request_(options.message_size, 'x'),
+      sent_(0),
+      received_(0),
+      closed_(false)
+  {
+  }
+
+  virtual ~load_connection()
+  {
+  }
+
+protected:
+  virtual void send(const char* data, std::size_t length) = 0;
+  virtual void close_socket() = 0;
+
+  //phase：开环时本连接第一个请求的偏移，各连接错开发送
+  void start(load_clock::time_point deadline, load_clock::duration phase)
+  {
+    deadline_ = deadline;
+    load_clock::time_point now = load_clock::now();
+    if (options_.rate > 0)
+    {
+      interval_ = std::chrono::duration_cast<load_clock::duration>(
+          std::chrono::duration<double>(options_.connections / options_.rate));
+      next_ = now + phase;
+      schedule();
+    }
+    else
+    {
+      for (std::size_t i = 0; i < options_.depth && now < deadline_; ++i)
+        send_request(now);
+      drain();
+    }
+  }
+
+  void on_reply(const char* data, std::size_t length)
+  {
+    load_clock::time_point now = load_clock::now();
+    if (length >= sizeof(std::int64_t))
+    {
+      std::int64_t stamp;
+      std::memcpy(&stamp, data, sizeof(stamp));
+      std::int64_t latency = std::chrono::duration_cast<std::chrono::nanoseconds>(
+          now.time_since_epoch()).count() - stamp;
+      stats_.latency.record(static_cast<std::uint64_t>(latency > 0 ? latency : 0));
+    }
+    ++received_;
+    ++stats_.received;
+
+    if (options_.rate <= 0 && now < deadline_)
+      send_request(now);  //闭环：收到一个补一个
+    else if (now >= deadline_ && received_ >= sent_)
+      close();  //全部收齐，提前结束
+  }
+
+  void on_error()
+  {
+    if (closed_)
+      return;
+    ++stats_.errors;
+    close();
+  }
+
+  bool closed() const
+  {
+    return closed_;
+  }
+
+private:
+  void send_request(load_clock::time_point intended)  //时间戳写计划发送时间
+  {
+    std::int64_t stamp = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        intended.time_since_epoch()).count();
+    std::memcpy(&request_[0], &stamp, sizeof(stamp));
+    ++sent_;
+    ++stats_.sent;
+    send(request_.data(), request_.size());
+  }
+
+  void schedule()  //开环：到点发出所有已到期的请求，落后时一次补发
+  {
+    timer_.expires_at(next_);
+    timer_.async_wait(
+        [this](boost::system::error_code ec)
+        {
+          if (ec || closed_)
+            return;
+          load_clock::time_point now = load_clock::now();
+          while (next_ <= now && next_ < deadline_)
+          {
+            send_request(next_);
+            next_ += interval_;
+          }
+          if (next_ < deadline_)
+            schedule();
+          else
+            drain();
+        });
+  }
+
+  void drain()  //截止后最多再等drain_ms
+  {
+    timer_.expires_at(deadline_ + std::chrono::milliseconds(options_.drain_ms));
+    timer_.async_wait(
+        [this](boost::system::error_code ec)
+        {
+          if (!ec)
+            close();
+        });
+  }
+
+  void close()
+  {
+    if (closed_)
+      return;
+    closed_ = true;
+    timer_.cancel();
+    close_socket();
+  }
+
+  boost::asio::steady_timer timer_;
+  const load_options& options_;
+  load_stats& stats_;
+  std::vector<char> request_;
+  load_clock::time_point deadline_;
+  load_clock::time_point next_;     //开环：下一个请求的计划发送时间
+  load_clock::duration interval_;
+  std::uint64_t sent_;
+  std::uint64_t received_;
+  bool closed_;
+};
+
+//----------------------------------------------------------------------
+//tcp连接：请求攒在pending_里，一次写出；回复按固定长度读
+class tcp_load_connection : public load_connection
+{
+public:
+  tcp_load_connection(boost::asio::io_context& io_context,
+      const load_options& options, load_stats& stats)
+    : load_connection(io_context, options, stats),
+      socket_(io_context),
+      reply_(options.message_size),
+      writing_(false)
+  {
+  }
+
+  void connect(const tcp::resolver::results_type& endpoints,
+      load_clock::time_point deadline, load_clock::duration phase)
+  {
+    boost::asio::async_connect(socket_, endpoints,
+        [this, deadline, phase](boost::system::error_code ec, const tcp::endpoint&)
+        {
+          if (ec)
+          {
+            on_error();
+            return;
+          }
+          socket_.set_option(tcp::no_delay(true));
+          do_read();
+          start(deadline, phase);
+        });
+  }
+
+private:
+  void send(const char* data, std::size_t length)
+  {
+    pending_.insert(pending_.end(), data, data + length);
+    if (!writing_)
+      do_write();
+  }
+
+  void close_socket()
+  {
+    boost::system::error_code ignored;
+    socket_.close(ignored);
+  }
+
+  void do_write()
+  {
+    writing_ = true;
+    sending_.swap(pending_);
+    pending_.clear();
+    boost::asio::async_write(socket_, boost::asio::buffer(sending_),
+        [this](boost::system::error_code ec, std::size_t /*length*/)
+        {
+          writing_ = false;
+          if (ec)
+          {
+            on_error();
+            return;
+          }
+          if (!pending_.empty())
+            do_write();
+        });
+  }
+
+  void do_read()
+  {
+    boost::asio::async_read(socket_, boost::asio::buffer(reply_),
+        [this](boost::system::error_code ec, std::size_t length)
+        {
+          if (ec)
+          {
+            on_error();
+            return;
+          }
+          on_reply(reply_.data(), length);
+          if (!closed())
+            do_read();
+        });
+  }
+
+  tcp::socket socket_;
+  std::vector<char> reply_;
+  std::vector<char> pending_;   //等待写出的请求
+  std::vector<char> sending_;   //正在写出
+  bool writing_;
+};
+
+//----------------------------------------------------------------------
+//udp连接：每个请求一个数据报，直接同步发送
+//闭环时丢包会让该连接的在途请求数减少
+class udp_load_connection : public load_connection
+{
+public:
+  udp_load_connection(boost::asio::io_context& io_context,
+      const load_options& options, load_stats& stats)
+    : load_connection(io_context, options, stats),
+      socket_(io_context),
+      reply_(options.message_size)
+  {
+  }
+
+  void connect(const udp::endpoint& endpoint,
+      load_clock::time_point deadline, load_clock::duration phase)
+  {
+    boost::system::error_code ec;
+    socket_.connect(endpoint, ec);  //只接收来自服务器的数据报
+    if (ec)
+    {
+      on_error();
+      return;
+    }
+    do_receive();
+    start(deadline, phase);
+  }
+
+private:
+  void send(const char* data, std::size_t length)
+  {
+    boost::system::error_code ec;
+    socket_.send(boost::asio::buffer(data, length), 0, ec);  //发送失败按丢包计
+  }
+
+  void close_socket()
+  {
+    boost::system::error_code ignored;
+    socket_.close(ignored);
+  }
+
+  void do_receive()
+  {
+    socket_.async_receive(boost::asio::buffer(reply_),
+        [this](boost::system::error_code ec, std::size_t length)
+        {
+          if (ec)
+          {
+            if (ec != boost::asio::error::connection_refused)
+            {
+              on_error();
+              return;
+            }
+          }
+          else
+          {
+            on_reply(reply_.data(), length);
+          }
+          if (!closed())
+            do_receive();
+        });
+  }
+
+  udp::socket socket_;
+  std::vector<char> reply_;
+};
+
+//----------------------------------------------------------------------
+//一个线程：一个io_context和分给它的连接
+class load_worker
+{
+public:
+  load_worker(const load_options& options)
+    : options_(options)
+  {
+  }
+
+  void add_tcp(const tcp::resolver::results_type& endpoints,
+      load_clock::time_point deadline, load_clock::duration phase)
+  {
+    tcp_load_connection* c = new tcp_load_connection(io_context_, options_, stats_);
+    connections_.emplace_back(c);
+    c->connect(endpoints, deadline, phase);
+  }
+
+  void add_udp(const udp::endpoint& endpoint,
+      load_clock::time_point deadline, load_clock::duration phase)
+  {
+    udp_load_connection* c = new udp_load_connection(io_context_, options_, stats_);
+    connections_.emplace_back(c);
+    c->connect(endpoint, deadline, phase);
+  }
+
+  void run()  //所有连接结束后返回
+  {
+    io_context_.run();
+  }
+
+  const load_stats& stats() const
+  {
+    return stats_;
+  }
+
+private:
+  boost::asio::io_context io_context_{1};
+  const load_options& options_;
+  load_stats stats_;
+  std::vector<std::unique_ptr<load_connection> > connections_;
+};
+
+//----------------------------------------------------------------------
+
+int main(int argc, char* argv[])
+{
+  try
+  {
+    load_options options;
+    int arg = 1;
+    for (; arg + 1 < argc && argv[arg][0] == '-'; arg += 2)
+    {
+      if (std::strcmp(argv[arg], "-u") == 0)  //协议
+        options.udp = std::strcmp(argv[arg + 1], "udp") == 0;
+      else if (std::strcmp(argv[arg], "-c") == 0)  //连接数
+        options.connections = std::max<std::size_t>(1, std::strtoul(argv[arg + 1], nullptr, 10));
+      else if (std::strcmp(argv[arg], "-t") == 0)  //线程数
+        options.threads = std::max<std::size_t>(1, std::strtoul(argv[arg + 1], nullptr, 10));
+      else if (std::strcmp(argv[arg], "-m") == 0)  //请求字节数
+        options.message_size = std::max<std::size_t>(8, std::strtoul(argv[arg + 1], nullptr, 10));
+      else if (std::strcmp(argv[arg], "-r") == 0)  //开环：每秒总请求数
+        options.rate = std::strtod(argv[arg + 1], nullptr);
+      else if (std::strcmp(argv[arg], "-d") == 0)  //闭环：流水线深度
+        options.depth = std::max<std::size_t>(1, std::strtoul(argv[arg + 1], nullptr, 10));
+      else if (std::strcmp(argv[arg], "-D") == 0)  //持续秒数
+        options.duration = std::strtoul(argv[arg + 1], nullptr, 10);
+      else if (std::strcmp(argv[arg], "-w") == 0)  //收尾等待毫秒数
+        options.drain_ms = std::strtoul(argv[arg + 1], nullptr, 10);
+      else
+        break;
+    }
+
+    if (arg + 2 != argc)
+    {
+      std::cerr << "Usage: echo_load [-u tcp|udp] [-c <connections>] [-t <threads>] [-m <message_size>]"
+        " [-r <requests_per_sec> | -d <pipeline_depth>] [-D <seconds>] [-w <drain_ms>] <host> <port>\n";
+      return 1;
+    }
+
+    boost::asio::io_context resolver_context;
+    std::vector<std::unique_ptr<load_worker> > workers;
+    for (std::size_t i = 0; i < options.threads; ++i)
+      workers.emplace_back(new load_worker(options));
+
+    load_clock::time_point deadline = load_clock::now() + std::chrono::seconds(options.duration);
+    load_clock::duration spread = options.rate > 0
+      ? std::chrono::duration_cast<load_clock::duration>(
+          std::chrono::duration<double>(options.connections / options.rate))
+      : load_clock::duration::zero();
+    if (options.udp)
+    {
+      udp::resolver resolver(resolver_context);
+      udp::endpoint endpoint = *resolver.resolve(udp::v4(), argv[arg], argv[arg + 1]).begin();
+      for (std::size_t i = 0; i < options.connections; ++i)
+        workers[i % workers.size()]->add_udp(endpoint, deadline,
+            std::chrono::duration_cast<load_clock::duration>(
+              spread * static_cast<double>(i) / options.connections));
+    }
+    else
+    {
+      tcp::resolver resolver(resolver_context);
+      tcp::resolver::results_type endpoints = resolver.resolve(argv[arg], argv[arg + 1]);
+      for (std::size_t i = 0; i < options.connections; ++i)
+        workers[i % workers.size()]->add_tcp(endpoints, deadline,
+            std::chrono::duration_cast<load_clock::duration>(
+              spread * static_cast<double>(i) / options.connections));
+    }
+
+    std::vector<std::thread> threads;
+    for (auto& w: workers)
+      threads.emplace_back([&w]() { w->run(); });
+    for (auto& t: threads)
+      t.join();
+
+    load_stats total;
+    for (auto& w: workers)
+    {
+      total.latency.add(w->stats().latency);
+      total.sent += w->stats().sent;
+      total.received += w->stats().received;
+      total.errors += w->stats().errors;
+    }
+
+    const latency_histogram& h = total.latency;
+    std::cout << "protocol=" << (options.udp ? "udp" : "tcp")
+      << " mode=" << (options.rate > 0 ? "open" : "closed")
+      << " connections=" << options.connections
+      << " threads=" << options.threads
+      << " message_size=" << options.message_size
+      << " rate=" << options.rate
+      << " depth=" << options.depth
+      << " duration=" << options.duration
+      << " sent=" << total.sent
+      << " received=" << total.received
+      << " lost=" << (total.sent > total.received ? total.sent - total.received : 0)
+      << " errors=" << total.errors
+      << " replies_per_sec=" << (options.duration ? total.received / double(options.duration) : 0.0)
+      << " min_us=" << h.min() / 1000.0
+      << " mean_us=" << h.mean() / 1000.0
+      << " p50_us=" << h.percentile(0.50) / 1000.0
+      << " p90_us=" << h.percentile(0.90) / 1000.0
+      << " p99_us=" << h.percentile(0.99) / 1000.0
+      << " p999_us=" << h.percentile(0.999) / 1000.0
+      << " p9999_us=" << h.percentile(0.9999) / 1000.0
+      << " max_us=" << h.max() / 1000.0 << "\n";
+  }
+  catch (std::exception& e)
+  {
+    std::cerr << "Exception: " << e.what() << "\n";
+  }
+
+  return 0;
+}
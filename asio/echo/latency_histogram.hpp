@@ -0,0 +1,125 @@
+//延迟直方图(HDR风格)：按2的幂分段，每段再等分128格，相对误差小于1%，记录一次只是一次数组加一
+#ifndef LATENCY_HISTOGRAM_HPP
+#define LATENCY_HISTOGRAM_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+//--------------------------------
+//数值单位由使用者决定(一般是纳秒)
+class latency_histogram
+{
+public:
+  enum { sub_bucket_bits = 7 };
+  enum { sub_bucket_count = 1 << sub_bucket_bits };
+  enum { bucket_count = (64 - sub_bucket_bits + 1) * sub_bucket_count };
+
+  latency_histogram()
+    : counts_(bucket_count),
+      total_(0),
+      min_(UINT64_MAX),
+      max_(0),
+      sum_(0)
+  {
+  }
+
+  void record(std::uint64_t value)
+  {
+    ++counts_[index(value)];
+    ++total_;
+    sum_ += value;
+    if (value < min_)
+      min_ = value;
+    if (value > max_)
+      max_ = value;
+  }
+
+  void add(const latency_histogram& other)  //合并其他线程的直方图
+  {
+    for (std::size_t i = 0; i < counts_.size(); ++i)
+      counts_[i] += other.counts_[i];
+    total_ += other.total_;
+    sum_ += other.sum_;
+    if (other.min_ < min_)
+      min_ = other.min_;
+    if (other.max_ > max_)
+      max_ = other.max_;
+  }
+
+  std::uint64_t count() const
+  {
+    return total_;
+  }
+
+  std::uint64_t min() const
+  {
+    return total_ != 0 ? min_ : 0;
+  }
+
+  std::uint64_t max() const
+  {
+    return max_;
+  }
+
+  double mean() const
+  {
+    return total_ != 0 ? static_cast<double>(sum_) / total_ : 0.0;
+  }
+
+  std::uint64_t percentile(double q) const  //q取0到1，返回所在格的上界
+  {
+    if (total_ == 0)
+      return 0;
+    std::uint64_t target = static_cast<std::uint64_t>(q * total_ + 0.5);
+    if (target == 0)
+      target = 1;
+    std::uint64_t seen = 0;
+    for (std::size_t i = 0; i < counts_.size(); ++i)
+    {
+      seen += counts_[i];
+      if (seen >= target)
+      {
+        std::uint64_t upper = highest_equivalent(i);
+        return upper < max_ ? upper : max_;
+      }
+    }
+    return max_;
+  }
+
+private:
+  static int highest_bit(std::uint64_t v)
+  {
+    int n = 0;
+    while (v >>= 1)
+      ++n;
+    return n;
+  }
+
+  //v < 128 时一格一个值；否则取最高7位之后的有效位，格宽随量级加倍
+  static std::size_t index(std::uint64_t v)
+  {
+    if (v < sub_bucket_count)
+      return static_cast<std::size_t>(v);
+    int shift = highest_bit(v) - sub_bucket_bits;
+    return static_cast<std::size_t>(shift + 1) * sub_bucket_count
+      + static_cast<std::size_t>((v >> shift) - sub_bucket_count);
+  }
+
+  static std::uint64_t highest_equivalent(std::size_t i)  //第i格的最大值
+  {
+    if (i < sub_bucket_count)
+      return i;
+    int shift = static_cast<int>(i / sub_bucket_count) - 1;
+    std::uint64_t low = (static_cast<std::uint64_t>(sub_bucket_count)
+        + i % sub_bucket_count) << shift;
+    return low + ((std::uint64_t(1) << shift) - 1);
+  }
+
+  std::vector<std::uint64_t> counts_;
+  std::uint64_t total_;
+  std::uint64_t min_;
+  std::uint64_t max_;
+  std::uint64_t sum_;
+};
+
+#endif // LATENCY_HISTOGRAM_HPP
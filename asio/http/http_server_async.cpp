@@ -28,6 +28,7 @@
 #include <string>
 #include <thread>
 #include <vector>
+#include "../allocation/thread_cache.hpp"
 
 using tcp = boost::asio::ip::tcp;       // from <boost/asio/ip/tcp.hpp>
 namespace http = boost::beast::http;    // from <boost/beast/http.hpp>
@@ -253,9 +254,9 @@ class session : public std::enable_shared_from_this<session>
         }
     };
 
-    tcp::socket socket_;
+    thread_cached_io<tcp::socket> socket_;  //异步操作的处理函数使用线程缓存
     boost::asio::strand<
-        boost::asio::io_context::executor_type> strand_;
+        tcp::socket::executor_type> strand_;
     boost::beast::flat_buffer buffer_;
     std::shared_ptr<std::string const> doc_root_;
     http::request<http::string_body> req_;
@@ -358,7 +359,7 @@ public:
 // 接受传入的连接并启动会话
 class listener : public std::enable_shared_from_this<listener>
 {
-    tcp::acceptor acceptor_;
+    thread_cached_io<tcp::acceptor> acceptor_;
     tcp::socket socket_;
     std::shared_ptr<std::string const> doc_root_;
 
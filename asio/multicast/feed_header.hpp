@@ -0,0 +1,54 @@
+//行情数据报头：8字节序号 + 8字节发送时间，网络字节序，后面是负载
+//发送时间是steady_clock的纳秒数，同一台机器上的收发进程可以直接相减得到延迟
+#ifndef FEED_HEADER_HPP
+#define FEED_HEADER_HPP
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+//--------------------------------
+struct feed_header
+{
+  enum { size = 16 };
+
+  std::uint64_t sequence;   //每个发送方从0开始连续编号
+  std::uint64_t send_time;  //纳秒
+
+  static std::uint64_t now()
+  {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+  }
+
+  void encode(char* data) const
+  {
+    put(data, sequence);
+    put(data + 8, send_time);
+  }
+
+  bool decode(const char* data, std::size_t length)  //数据报太短返回false
+  {
+    if (length < size)
+      return false;
+    sequence = get(data);
+    send_time = get(data + 8);
+    return true;
+  }
+
+private:
+  static void put(char* p, std::uint64_t v)
+  {
+    for (int i = 7; i >= 0; --i, v >>= 8)
+      p[i] = static_cast<char>(v & 0xff);
+  }
+
+  static std::uint64_t get(const char* p)
+  {
+    std::uint64_t v = 0;
+    for (int i = 0; i < 8; ++i)
+      v = (v << 8) | static_cast<unsigned char>(p[i]);
+    return v;
+  }
+};
+
+#endif // FEED_HEADER_HPP
@@ -0,0 +1,76 @@
+//NACK报文：接收方用单播发给组播发送方，一个数据报里汇总多个缺失区间
+//格式：4字节"NACK" + 2字节区间数 + 每个区间8字节起始序号、4字节个数，网络字节序
+#ifndef NACK_MESSAGE_HPP
+#define NACK_MESSAGE_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+//--------------------------------
+struct nack_range
+{
+  std::uint64_t first;
+  std::uint32_t count;
+};
+//--------------------------------
+class nack_message
+{
+public:
+  enum { header_size = 6 };
+  enum { range_size = 12 };
+  enum { max_ranges = 100 };   //一个数据报不超过1206字节，不会被分片
+  enum { max_size = header_size + max_ranges * range_size };
+
+  //编码从ranges开始的count个区间中前max_ranges个，返回字节数
+  static std::size_t encode(const nack_range* ranges, std::size_t count, char* data)
+  {
+    std::size_t n = std::min<std::size_t>(count, max_ranges);
+    std::memcpy(data, "NACK", 4);
+    put(data + 4, n, 2);
+    char* p = data + header_size;
+    for (std::size_t i = 0; i < n; ++i, p += range_size)
+    {
+      put(p, ranges[i].first, 8);
+      put(p + 8, ranges[i].count, 4);
+    }
+    return header_size + n * range_size;
+  }
+
+  static bool decode(const char* data, std::size_t length, std::vector<nack_range>& ranges)
+  {
+    ranges.clear();
+    if (length < header_size || std::memcmp(data, "NACK", 4) != 0)
+      return false;
+    std::size_t n = static_cast<std::size_t>(get(data + 4, 2));
+    if (length < header_size + n * range_size)
+      return false;
+    const char* p = data + header_size;
+    for (std::size_t i = 0; i < n; ++i, p += range_size)
+    {
+      nack_range r;
+      r.first = get(p, 8);
+      r.count = static_cast<std::uint32_t>(get(p + 8, 4));
+      ranges.push_back(r);
+    }
+    return true;
+  }
+
+private:
+  static void put(char* p, std::uint64_t v, int bytes)
+  {
+    for (int i = bytes - 1; i >= 0; --i, v >>= 8)
+      p[i] = static_cast<char>(v & 0xff);
+  }
+
+  static std::uint64_t get(const char* p, int bytes)
+  {
+    std::uint64_t v = 0;
+    for (int i = 0; i < bytes; ++i)
+      v = (v << 8) | static_cast<unsigned char>(p[i]);
+    return v;
+  }
+};
+
+#endif // NACK_MESSAGE_HPP
@@ -0,0 +1,100 @@
+//接收方的NACK调度：记录一个发送方的缺口，到期时按已收到的情况重算仍缺的区间，汇总成一个NACK
+//每个缺口最多请求max_attempts次，间隔逐次加长；超出次数或滑出序号窗口的包算作永久丢失
+#ifndef NACK_SCHEDULER_HPP
+#define NACK_SCHEDULER_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "nack_message.hpp"
+#include "sequence_tracker.hpp"
+//--------------------------------
+//用法：sequence_tracker报告gap时on_gap(旧的next, 新包序号, now) -> 定期collect()，ranges非空就发NACK
+class nack_scheduler
+{
+public:
+  //interval是第一次请求前的等待时间(给乱序的包留出时间)，也是重试间隔的单位
+  nack_scheduler(std::uint64_t interval, unsigned max_attempts)
+    : interval_(interval),
+      max_attempts_(max_attempts)
+  {
+  }
+
+  void on_gap(std::uint64_t first, std::uint64_t end, std::uint64_t now)  //缺[first, end)
+  {
+    gaps_.push_back(gap{first, end, 0, now + interval_});
+  }
+
+  bool empty() const
+  {
+    return gaps_.empty();
+  }
+
+  //到期的缺口按tracker重算，仍缺的区间追加到ranges，返回本次放弃的包数
+  std::uint64_t collect(const sequence_tracker& tracker, std::uint64_t now,
+      std::vector<nack_range>& ranges)
+  {
+    std::uint64_t lost = 0;
+    for (std::size_t i = 0; i < gaps_.size(); )
+    {
+      gap& g = gaps_[i];
+      if (g.due > now)
+      {
+        ++i;
+        continue;
+      }
+      std::uint64_t oldest = tracker.next() > tracker.window() ?
+        tracker.next() - tracker.window() : 0;
+      if (g.first < oldest)   //滑出窗口的部分已经无法判断，算作丢失
+      {
+        std::uint64_t end = g.end < oldest ? g.end : oldest;
+        lost += end - g.first;
+        g.first = end;
+      }
+      std::size_t before = ranges.size();
+      std::uint64_t first_missing = g.end, last_missing = g.first, missing = 0;
+      for (std::uint64_t s = g.first; s < g.end; ++s)
+      {
+        if (tracker.has(s))
+          continue;
+        ++missing;
+        if (first_missing == g.end)
+          first_missing = s;
+        last_missing = s;
+        if (ranges.size() > before && ranges.back().first + ranges.back().count == s)
+          ++ranges.back().count;
+        else
+          ranges.push_back(nack_range{s, 1});
+      }
+      if (missing == 0 || g.attempts >= max_attempts_)
+      {
+        lost += g.attempts >= max_attempts_ ? missing : 0;
+        ranges.resize(before);
+        gaps_[i] = gaps_.back();
+        gaps_.pop_back();
+        continue;
+      }
+      ++g.attempts;
+      g.first = first_missing;
+      g.end = last_missing + 1;
+      g.due = now + interval_ * (g.attempts + 1);   //重试间隔逐次加长
+      ++i;
+    }
+    return lost;
+  }
+
+private:
+  struct gap
+  {
+    std::uint64_t first;
+    std::uint64_t end;
+    unsigned attempts;
+    std::uint64_t due;
+  };
+
+  std::uint64_t interval_;
+  unsigned max_attempts_;
+  std::vector<gap> gaps_;
+};
+
+#endif // NACK_SCHEDULER_HPP
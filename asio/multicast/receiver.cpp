@@ -1,7 +1,25 @@
+#include <algorithm>
 #include <array>
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
+#include <map>
+#include <memory>
+#include <random>
+#include <sstream>
 #include <string>
+#include <thread>
 #include <boost/asio.hpp>
+#include "../echo/latency_histogram.hpp"
+#include "../udp/packet_ring.hpp"
+#include "feed_header.hpp"
+#include "nack_message.hpp"
+#include "nack_scheduler.hpp"
+#include "sequence_tracker.hpp"
 
 constexpr short multicast_port = 30001;
 
@@ -47,14 +65,322 @@ private:
   boost::asio::ip::udp::endpoint sender_endpoint_;
   std::array<char, 1024> data_;
 };
+//-------------------------------------------
+//行情计数。只有一个线程写，其他线程可以随时读
+struct feed_counters
+{
+  std::atomic<std::uint64_t> packets{0};
+  std::atomic<std::uint64_t> bytes{0};
+  std::atomic<std::uint64_t> missing{0};      //按序号算出的仍缺的包数
+  std::atomic<std::uint64_t> duplicates{0};
+  std::atomic<std::uint64_t> late{0};         //乱序迟到、补上了缺口的包
+  std::atomic<std::uint64_t> malformed{0};    //短于报头
+  std::atomic<std::uint64_t> overflows{0};    //队列满时丢弃的包(接收线程写)
+  std::atomic<std::uint64_t> receive_errors{0};  //除would_block以外的接收错误(接收线程写)
+  std::atomic<std::uint64_t> injected_drops{0};  //模拟丢包丢掉的
+  std::atomic<std::uint64_t> nacks_sent{0};
+  std::atomic<std::uint64_t> nack_ranges{0};
+  std::atomic<std::uint64_t> unrecovered{0};  //请求重传仍没收到，放弃的包
+
+  static void add(std::atomic<std::uint64_t>& counter, std::uint64_t n)
+  {
+    counter.store(counter.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+  }
+};
+//-------------------------------------------
+struct feed_options
+{
+  std::size_t ring_slots = 4096;
+  std::size_t report_seconds = 1;
+  std::size_t nack_ms = 0;           //0为不请求重传
+  unsigned nack_attempts = 8;
+  double loss_percent = 0;           //处理前随机丢掉的比例，在环回上模拟丢包
+  std::size_t idle_spins = 1000;     //队列空时先让出CPU自旋的次数，之后改为睡眠，不长期占满一个核
+};
+//-------------------------------------------
+//行情接收：io线程等待可读后用recvmmsg把数据报批量收进预分配的环形队列，
+//处理线程从队列取出，按发送方检查序号的缺口和重复，统计发送到处理的延迟
+//打开NACK时处理线程把各发送方仍缺的区间汇总，定期用单播发回给发送方
+class feed_receiver
+{
+public:
+  enum { slot_size = 2048 };
+  enum { idle_sleep_us = 100 };   //自旋结束后每次睡眠的时间
+
+  feed_receiver(boost::asio::io_context& io_context,
+      const boost::asio::ip::address& listen_address,
+      const boost::asio::ip::address& multicast_address,
+      const feed_options& options)
+    : options_(options),
+      socket_(io_context),
+      nack_socket_(io_context, multicast_address.is_v4() ?
+          boost::asio::ip::udp::v4() : boost::asio::ip::udp::v6()),
+      ring_(options.ring_slots, slot_size),
+      report_interval_(options.report_seconds),
+      stopping_(false)
+  {
+    boost::asio::ip::udp::endpoint listen_endpoint(
+        listen_address, multicast_port);
+    socket_.open(listen_endpoint.protocol());
+    socket_.set_option(boost::asio::ip::udp::socket::reuse_address(true));
+    socket_.set_option(boost::asio::socket_base::receive_buffer_size(8 << 20));
+    socket_.bind(listen_endpoint);
+
+    // 加入组播组
+    socket_.set_option(
+        boost::asio::ip::multicast::join_group(multicast_address));
+    socket_.non_blocking(true);   //队列满时丢弃数据报不能阻塞
+
+    consumer_ = std::thread([this]() { consume(); });
+    do_wait();
+  }
+
+  ~feed_receiver()
+  {
+    stopping_.store(true);
+    consumer_.join();   //处理线程退出前打印最终统计
+  }
+
+  const feed_counters& counters() const
+  {
+    return counters_;
+  }
+
+private:
+  void do_wait()  //等待可读
+  {
+    socket_.async_wait(boost::asio::ip::udp::socket::wait_read,
+        [this](boost::system::error_code ec)
+        {
+          if (!ec)
+          {
+            drain();
+            do_wait();
+          }
+        });
+  }
+
+  void drain()  //收空接收缓冲区；队列满时丢弃并计数，不让内核缓冲区里积压旧数据
+  {
+    boost::system::error_code ec;
+    for (;;)
+    {
+      std::size_t n = ring_.receive(socket_, feed_header::now, ec);
+      if (!ec && n == 0)
+      {
+        socket_.receive(boost::asio::buffer(scratch_), 0, ec);
+        if (!ec)
+          feed_counters::add(counters_.overflows, 1);
+      }
+      if (ec)   //任何错误都结束本轮，由do_wait()重新等待
+      {
+        if (ec != boost::asio::error::would_block)
+          feed_counters::add(counters_.receive_errors, 1);
+        break;
+      }
+    }
+  }
+
+  void consume()  //处理线程
+  {
+    auto next_report = std::chrono::steady_clock::now() + report_interval_;
+    std::uint64_t next_nack = 0;
+    std::uint64_t last_packets = 0;
+    std::size_t idle = 0;
+    for (;;)
+    {
+      std::size_t n = ring_.readable();
+      if (n == 0)
+      {
+        if (stopping_.load())
+          break;
+        if (++idle <= options_.idle_spins)
+          std::this_thread::yield();
+        else
+          std::this_thread::sleep_for(std::chrono::microseconds(idle_sleep_us));
+      }
+      else
+      {
+        idle = 0;
+      }
+      std::size_t first = ring_.read_index();
+      for (std::size_t i = 0; i < n; ++i)
+        on_packet(ring_.at(first + i));
+      ring_.release(n);
+
+      if (options_.nack_ms != 0 && feed_header::now() >= next_nack)  //每毫秒检查一次到期的缺口
+      {
+        send_nacks(feed_header::now());
+        next_nack = feed_header::now() + 1000000;
+      }
+      if (report_interval_.count() != 0 && std::chrono::steady_clock::now() >= next_report)
+      {
+        std::uint64_t packets = counters_.packets.load();
+        report(std::cout, (packets - last_packets) / report_interval_.count());
+        latency_ = latency_histogram();   //延迟按每个周期统计
+        last_packets = packets;
+        next_report += report_interval_;
+      }
+    }
+    report(std::cout, 0);
+    for (auto& s: senders_)
+    {
+      const sequence_tracker& t = s.second.tracker;
+      std::cout << "sender=" << s.first
+        << " received=" << t.received()
+        << " next=" << t.next()
+        << " missing=" << t.missing()
+        << " duplicates=" << t.duplicates()
+        << " late=" << t.late_packets()
+        << " stale=" << t.stale_packets() << std::endl;
+    }
+  }
+
+  void on_packet(const packet_ring::slot& s)
+  {
+    if (options_.loss_percent > 0 && drop_(random_))  //模拟丢包
+    {
+      feed_counters::add(counters_.injected_drops, 1);
+      return;
+    }
+    feed_counters::add(counters_.packets, 1);
+    feed_counters::add(counters_.bytes, s.length);
+    feed_header header;
+    if (!header.decode(s.data, s.length))
+    {
+      feed_counters::add(counters_.malformed, 1);
+      return;
+    }
+    if (s.receive_time > header.send_time)
+      latency_.record(s.receive_time - header.send_time);
+
+    auto it = senders_.find(s.sender);
+    if (it == senders_.end())
+      it = senders_.emplace(s.sender, source(nack_interval(), options_.nack_attempts)).first;
+    std::uint64_t expected = it->second.tracker.next();
+    sequence_tracker::result r = it->second.tracker.on_packet(header.sequence);
+    if (r == sequence_tracker::duplicate)
+      feed_counters::add(counters_.duplicates, 1);
+    if (r == sequence_tracker::gap && options_.nack_ms != 0)
+      it->second.nacks.on_gap(expected, header.sequence, s.receive_time);
+    if (r != sequence_tracker::gap && r != sequence_tracker::late)
+      return;
+    std::uint64_t missing = 0, late = 0;   //缺口变化时重新汇总
+    for (auto& t: senders_)
+    {
+      missing += t.second.tracker.missing();
+      late += t.second.tracker.late_packets();
+    }
+    counters_.missing.store(missing, std::memory_order_relaxed);
+    counters_.late.store(late, std::memory_order_relaxed);
+  }
+
+  //每个发送方到期的缺口汇总成一个NACK，单播发给它
+  void send_nacks(std::uint64_t now)
+  {
+    for (auto& s: senders_)
+    {
+      if (s.second.nacks.empty())
+        continue;
+      nack_ranges_.clear();
+      feed_counters::add(counters_.unrecovered,
+          s.second.nacks.collect(s.second.tracker, now, nack_ranges_));
+      for (std::size_t i = 0; i < nack_ranges_.size(); i += nack_message::max_ranges)
+      {
+        std::size_t count = std::min<std::size_t>(nack_ranges_.size() - i,
+            nack_message::max_ranges);   //超过一个数据报的区间分成多个NACK
+        std::size_t n = nack_message::encode(nack_ranges_.data() + i, count, nack_buffer_.data());
+        boost::system::error_code ec;
+        nack_socket_.send_to(boost::asio::buffer(nack_buffer_.data(), n), s.first, 0, ec);
+        feed_counters::add(counters_.nacks_sent, 1);
+        feed_counters::add(counters_.nack_ranges, count);
+      }
+    }
+  }
+
+  std::uint64_t nack_interval() const  //纳秒
+  {
+    return options_.nack_ms * 1000000;
+  }
+
+  void report(std::ostream& os, std::uint64_t pps)
+  {
+    os << "packets=" << counters_.packets.load()
+      << " pps=" << pps
+      << " senders=" << senders_.size()
+      << " missing=" << counters_.missing.load()
+      << " duplicates=" << counters_.duplicates.load()
+      << " late=" << counters_.late.load()
+      << " malformed=" << counters_.malformed.load()
+      << " overflows=" << counters_.overflows.load()
+      << " receive_errors=" << counters_.receive_errors.load()
+      << " injected_drops=" << counters_.injected_drops.load()
+      << " nacks_sent=" << counters_.nacks_sent.load()
+      << " nack_ranges=" << counters_.nack_ranges.load()
+      << " unrecovered=" << counters_.unrecovered.load()
+      << " latency_p50_us=" << latency_.percentile(0.5) / 1000.0
+      << " latency_p99_us=" << latency_.percentile(0.99) / 1000.0
+      << " latency_max_us=" << latency_.max() / 1000.0 << std::endl;
+  }
+
+  struct source   //一个发送方
+  {
+    source(std::uint64_t nack_interval, unsigned nack_attempts)
+      : nacks(nack_interval, nack_attempts)
+    {
+    }
+
+    sequence_tracker tracker;
+    nack_scheduler nacks;
+  };
+
+  feed_options options_;
+  boost::asio::ip::udp::socket socket_;
+  boost::asio::ip::udp::socket nack_socket_;   //只在处理线程里同步发送
+  packet_ring ring_;
+  std::array<char, slot_size> scratch_;
+  feed_counters counters_;
+  std::chrono::seconds report_interval_;
+  std::atomic<bool> stopping_;
+  std::thread consumer_;
+
+  //以下只在处理线程里访问
+  std::map<boost::asio::ip::udp::endpoint, source> senders_;
+  latency_histogram latency_;
+  std::minstd_rand random_;
+  std::bernoulli_distribution drop_{options_.loss_percent / 100.0};
+  std::vector<nack_range> nack_ranges_;
+  std::array<char, nack_message::max_size> nack_buffer_;
+};
 
 int main(int argc, char* argv[])
 {
   try
   {
-    if (argc != 3)
+    bool feed = false;
+    feed_options options;
+    int arg = 1;
+    for (; arg + 1 < argc && argv[arg][0] == '-'; arg += 2)
     {
-      std::cerr << "Usage: receiver <listen_address> <multicast_address>\n";
+      if (std::strcmp(argv[arg], "-m") == 0)  //print逐条打印，feed按行情处理
+        feed = std::strcmp(argv[arg + 1], "feed") == 0;
+      else if (std::strcmp(argv[arg], "-q") == 0)  //环形队列的槽位数
+        options.ring_slots = std::strtoul(argv[arg + 1], nullptr, 10);
+      else if (std::strcmp(argv[arg], "-s") == 0)  //打印统计的间隔(秒)，0为只在退出时打印
+        options.report_seconds = std::strtoul(argv[arg + 1], nullptr, 10);
+      else if (std::strcmp(argv[arg], "-n") == 0)  //发现缺口后多少毫秒请求重传，0为不请求
+        options.nack_ms = std::strtoul(argv[arg + 1], nullptr, 10);
+      else if (std::strcmp(argv[arg], "-l") == 0)  //模拟丢包的百分比
+        options.loss_percent = std::atof(argv[arg + 1]);
+      else if (std::strcmp(argv[arg], "-y") == 0)  //队列空时先自旋的次数，之后睡眠
+        options.idle_spins = std::strtoul(argv[arg + 1], nullptr, 10);
+      else
+        break;
+    }
+    if (arg + 2 != argc)
+    {
+      std::cerr << "Usage: receiver [-m print|feed] [-q <ring_slots>] [-s <report_seconds>]"
+        " [-n <nack_ms>] [-l <loss_percent>] [-y <idle_spins>] <listen_address> <multicast_address>\n";
       std::cerr << "  For IPv4, try:\n";
       std::cerr << "    receiver 0.0.0.0 239.255.0.1\n";
       std::cerr << "  For IPv6, try:\n";
@@ -63,10 +389,28 @@ int main(int argc, char* argv[])
     }
 
     boost::asio::io_context io_context;
-    receiver r(io_context,
-        boost::asio::ip::make_address(argv[1]),
-        boost::asio::ip::make_address(argv[2]));
-    io_context.run();
+    if (feed)
+    {
+      feed_receiver r(io_context,
+          boost::asio::ip::make_address(argv[arg]),
+          boost::asio::ip::make_address(argv[arg + 1]),
+          options);
+
+      boost::asio::signal_set signals(io_context, SIGINT, SIGTERM);  //退出时打印各发送方的统计
+      signals.async_wait(
+          [&io_context](boost::system::error_code /*ec*/, int /*signo*/)
+          {
+            io_context.stop();
+          });
+      io_context.run();
+    }
+    else
+    {
+      receiver r(io_context,
+          boost::asio::ip::make_address(argv[arg]),
+          boost::asio::ip::make_address(argv[arg + 1]));
+      io_context.run();
+    }
   }
   catch (std::exception& e)
   {
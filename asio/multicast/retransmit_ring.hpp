@@ -0,0 +1,123 @@
+//发送方的重传环：按序号保存最近capacity个已发出的包，收到NACK时取出重发
+//同一个序号在suppress时间内只重发一次，多个接收方同时报告同一个缺口也只发一遍
+//排队的包数有上限，超出的请求直接丢弃，接收方稍后会再请求
+#ifndef RETRANSMIT_RING_HPP
+#define RETRANSMIT_RING_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <vector>
+//--------------------------------
+//用法：发出一个包后store(seq, data, n) -> 收到NACK时request(seq, now) -> 每个周期next()取出待重发的序号
+class retransmit_ring
+{
+public:
+  enum request_result { queued, suppressed, unavailable, overloaded };
+
+  //capacity取整到2的幂
+  retransmit_ring(std::size_t capacity, std::size_t packet_size, std::size_t max_pending)
+    : packet_size_(packet_size),
+      max_pending_(max_pending),
+      entries_(round_up(capacity)),
+      buffer_(round_up(capacity) * packet_size),
+      mask_(round_up(capacity) - 1)
+  {
+  }
+
+  retransmit_ring(const retransmit_ring&) = delete;
+  retransmit_ring& operator=(const retransmit_ring&) = delete;
+
+  std::size_t capacity() const
+  {
+    return entries_.size();
+  }
+
+  void store(std::uint64_t sequence, const char* data, std::size_t length)  //覆盖最旧的包
+  {
+    entry& e = entries_[sequence & mask_];
+    e.sequence = sequence;
+    e.valid = true;
+    e.queued = false;
+    e.last_retransmit = 0;
+    e.length = length < packet_size_ ? length : packet_size_;
+    std::memcpy(this->data(sequence), data, e.length);
+  }
+
+  //把一个序号排进重发队列，now和suppress单位相同(纳秒)
+  request_result request(std::uint64_t sequence, std::uint64_t now, std::uint64_t suppress)
+  {
+    entry& e = entries_[sequence & mask_];
+    if (!e.valid || e.sequence != sequence)
+      return unavailable;   //太旧，已被覆盖，或者还没发出
+    if (e.queued || (e.last_retransmit != 0 && now - e.last_retransmit < suppress))
+      return suppressed;
+    if (pending_.size() >= max_pending_)
+      return overloaded;
+    e.queued = true;
+    pending_.push_back(sequence);
+    return queued;
+  }
+
+  std::size_t pending() const
+  {
+    return pending_.size();
+  }
+
+  //取出下一个待重发的包，没有返回false；排队期间被覆盖的跳过
+  bool next(std::uint64_t now, std::uint64_t& sequence)
+  {
+    while (!pending_.empty())
+    {
+      std::uint64_t s = pending_.front();
+      pending_.pop_front();
+      entry& e = entries_[s & mask_];
+      if (e.valid && e.sequence == s && e.queued)
+      {
+        e.queued = false;
+        e.last_retransmit = now;
+        sequence = s;
+        return true;
+      }
+    }
+    return false;
+  }
+
+  char* data(std::uint64_t sequence)
+  {
+    return buffer_.data() + (sequence & mask_) * packet_size_;
+  }
+
+  std::size_t length(std::uint64_t sequence) const
+  {
+    return entries_[sequence & mask_].length;
+  }
+
+private:
+  struct entry
+  {
+    std::uint64_t sequence = 0;
+    std::uint64_t last_retransmit = 0;
+    std::size_t length = 0;
+    bool valid = false;
+    bool queued = false;
+  };
+
+  static std::size_t round_up(std::size_t n)
+  {
+    std::size_t p = 1;
+    while (p < n)
+      p <<= 1;
+    return p;
+  }
+
+  std::size_t packet_size_;
+  std::size_t max_pending_;
+  std::vector<entry> entries_;
+  std::vector<char> buffer_;
+  std::size_t mask_;
+  std::deque<std::uint64_t> pending_;
+};
+
+#endif // RETRANSMIT_RING_HPP
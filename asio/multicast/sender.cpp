@@ -1,25 +1,80 @@
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <csignal>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
 #include <sstream>
 #include <string>
+#include <vector>
 #include <boost/asio.hpp>
+#include "../echo/latency_histogram.hpp"
+#include "../udp/packet_batch.hpp"
+#include "../udp/udp_offload.hpp"
+#include "feed_header.hpp"
+#include "nack_message.hpp"
+#include "retransmit_ring.hpp"
 
 constexpr short multicast_port = 30001;
 constexpr int max_message_count = 10;
+constexpr std::size_t segment_size = 32;  //分段发送时每条消息补齐到这个长度
 
 class sender
 {
 public:
+  //segments大于1时每次定时发出segments条等长消息，用GSO一次sendmsg发完
   sender(boost::asio::io_context& io_context,
-      const boost::asio::ip::address& multicast_address)
+      const boost::asio::ip::address& multicast_address, std::size_t segments = 1)
     : endpoint_(multicast_address, multicast_port),
       socket_(io_context, endpoint_.protocol()),
       timer_(io_context),
-      message_count_(0)
+      message_count_(0),
+      segments_(segments)
   {
-    do_send();
+    socket_.non_blocking(true);   //GSO发送遇到发送缓冲区满时不阻塞，等待可写后继续
+    if (segments_ > 1)
+      do_send_segments();
+    else
+      do_send();
   }
 
 private:
+  void do_send_segments()  //一批消息拼成一块，内核按segment_size拆成多个数据报
+  {
+    message_.assign(segments_ * segment_size, ' ');
+    for (std::size_t i = 0; i < segments_; ++i)
+    {
+      std::ostringstream os;
+      os << "Message " << message_count_ << "." << i;
+      std::string text = os.str().substr(0, segment_size);
+      message_.replace(i * segment_size, text.size(), text);
+    }
+    ++message_count_;
+    send_segments(0);
+  }
+
+  void send_segments(std::size_t first)  //从第first段开始发出
+  {
+    std::size_t offset = first * segment_size;
+    boost::system::error_code ec;
+    std::size_t sent = segment_sender_.send(socket_, endpoint_, message_.data() + offset,
+        message_.size() - offset, segment_size, ec);
+    if (ec == boost::asio::error::would_block)
+    {
+      socket_.async_wait(boost::asio::ip::udp::socket::wait_write,
+          [this, first, sent](boost::system::error_code ec)
+          {
+            if (!ec)
+              send_segments(first + sent);
+          });
+      return;
+    }
+    if (!ec && message_count_ < max_message_count)
+      do_timeout();
+  }
+
   void do_send()
   {
     std::ostringstream os;
@@ -41,7 +96,9 @@ private:
     timer_.async_wait(
         [this](boost::system::error_code ec)
         {
-          if (!ec)
+          if (!ec && segments_ > 1)
+            do_send_segments();
+          else if (!ec)
             do_send();//继续发送
         });
   }
@@ -52,15 +109,344 @@ private:
   boost::asio::steady_timer timer_;
   int message_count_;
   std::string message_;
+  std::size_t segments_;
+  segment_sender segment_sender_;
+};
+
+//-------------------------------------------
+//按速率发送行情：定时器每个周期醒来，令牌桶按实际经过的时间补充令牌，有多少令牌发多少个包
+//负载预先填好，每个包只改写报头里的序号和发送时间，一批用一次sendmmsg发出
+//定时器醒来比计划晚的时间记入直方图，就是发送端的抖动
+//打开重传时最近发出的包留在重传环里，接收方单播来的NACK把缺失的序号排进队列，
+//每个周期按重传速率上限重新组播，一个丢包严重的接收方不会引起重传风暴
+struct pacing_options
+{
+  std::uint64_t rate = 100000;          //每秒包数
+  std::size_t packet_size = 64;         //含报头
+  std::size_t seconds = 0;              //0为一直发送
+  std::size_t tick_us = 1000;           //定时器周期
+  std::size_t batch = 64;               //一次sendmmsg的包数
+  std::size_t burst_ticks = 4;          //最多积攒几个周期的令牌，落后太多时不一次补发
+  std::size_t retransmit_ring = 0;      //保留最近多少个包用于重传，0为不重传
+  std::uint64_t retransmit_rate = 0;    //每秒最多重传的包数，0为rate的十分之一
+  std::size_t suppress_us = 2000;       //同一个包重传后这段时间内不再重传
+  std::size_t linger_ms = 1000;         //发送结束后继续处理NACK的时间
+};
+
+class paced_sender
+{
+public:
+  paced_sender(boost::asio::io_context& io_context,
+      const boost::asio::ip::address& multicast_address, const pacing_options& options)
+    : options_(options),
+      io_context_(io_context),
+      socket_(io_context, multicast_address.is_v4() ?
+          boost::asio::ip::udp::v4() : boost::asio::ip::udp::v6()),
+      timer_(io_context),
+      batch_(options.batch, options.packet_size),
+      retransmits_(options.retransmit_ring != 0 ? options.retransmit_ring : 1,
+          options.packet_size, max_pending(options)),
+      tick_(std::chrono::microseconds(options.tick_us)),
+      tokens_(0),
+      retransmit_tokens_(0),
+      sequence_(0),
+      last_sent_(0)
+  {
+    socket_.set_option(boost::asio::socket_base::send_buffer_size(8 << 20));
+    socket_.bind(boost::asio::ip::udp::endpoint(socket_.local_endpoint().protocol(), 0));  //NACK发到这个端口
+    socket_.non_blocking(true);   //发送缓冲区满时不阻塞定时器，留到下个周期
+    destination_ = boost::asio::ip::udp::endpoint(multicast_address, multicast_port);
+    for (std::size_t i = 0; i < batch_.capacity(); ++i)  //负载只填一次
+    {
+      std::memset(batch_.data(i), 'x', options_.packet_size);
+      batch_.length(i, options_.packet_size);
+      batch_.endpoint(i) = destination_;
+    }
+    if (options_.retransmit_rate == 0)
+      options_.retransmit_rate = options_.rate / 10 > 1000 ? options_.rate / 10 : 1000;
+    if (reliable())
+      do_receive_nack();
+    start_ = std::chrono::steady_clock::now();
+    last_refill_ = start_;
+    next_tick_ = start_;
+    next_report_ = start_ + std::chrono::seconds(1);
+    do_tick();
+  }
+
+  std::uint64_t sent() const
+  {
+    return sequence_;
+  }
+
+  void report(std::ostream& os, std::uint64_t pps)
+  {
+    os << "sent=" << sequence_
+      << " pps=" << pps
+      << " errors=" << errors_
+      << " send_full=" << send_full_
+      << " missed_ticks=" << missed_ticks_;
+    if (reliable())
+    {
+      os << " nacks=" << nacks_
+        << " retransmits=" << retransmitted_
+        << " suppressed=" << suppressed_
+        << " unavailable=" << unavailable_
+        << " overloaded=" << overloaded_
+        << " retransmit_pending=" << retransmits_.pending();
+    }
+    os      << " tick_late_p50_us=" << late_.percentile(0.5) / 1000.0
+      << " tick_late_p99_us=" << late_.percentile(0.99) / 1000.0
+      << " tick_late_max_us=" << late_.max() / 1000.0 << std::endl;
+  }
+
+private:
+  //排队的重传最多是0.1秒的重传量，更早的请求等不到发送就已经过时
+  static std::size_t max_pending(const pacing_options& options)
+  {
+    std::uint64_t rate = options.retransmit_rate != 0 ? options.retransmit_rate
+      : (options.rate / 10 > 1000 ? options.rate / 10 : 1000);
+    return rate / 10 > 64 ? static_cast<std::size_t>(rate / 10) : 64;
+  }
+
+  bool reliable() const
+  {
+    return options_.retransmit_ring != 0;
+  }
+
+  void do_receive_nack()  //接收方单播来的NACK
+  {
+    socket_.async_receive_from(
+        boost::asio::buffer(nack_buffer_), nack_sender_,
+        [this](boost::system::error_code ec, std::size_t length)
+        {
+          if (ec == boost::asio::error::operation_aborted)
+            return;
+          if (!ec && nack_message::decode(nack_buffer_.data(), length, nack_ranges_))
+          {
+            ++nacks_;
+            on_nack();
+          }
+          do_receive_nack();
+        });
+  }
+
+  void on_nack()  //缺失的序号排进重传队列，实际发送在定时器里限速
+  {
+    std::uint64_t now = feed_header::now();
+    std::uint64_t suppress = options_.suppress_us * 1000;
+    for (const nack_range& r: nack_ranges_)
+    {
+      std::uint64_t count = r.count < retransmits_.capacity() ? r.count : retransmits_.capacity();
+      for (std::uint64_t s = r.first; s < r.first + count; ++s)
+      {
+        switch (retransmits_.request(s, now, suppress))
+        {
+        case retransmit_ring::queued:
+          break;
+        case retransmit_ring::suppressed:
+          ++suppressed_;
+          break;
+        case retransmit_ring::unavailable:
+          ++unavailable_;
+          break;
+        case retransmit_ring::overloaded:
+          ++overloaded_;
+          break;
+        }
+      }
+    }
+  }
+
+  void send_retransmits()  //按重传令牌发送排队的包，发不完的留到下个周期
+  {
+    std::uint64_t now = feed_header::now();
+    std::uint64_t sequence;
+    boost::system::error_code ec;
+    while (retransmit_tokens_ >= 1 && retransmits_.next(now, sequence))
+    {
+      socket_.send_to(boost::asio::buffer(retransmits_.data(sequence),
+            retransmits_.length(sequence)), destination_, 0, ec);
+      if (ec == boost::asio::error::would_block)
+      {
+        ++send_full_;   //这个包等接收方再次请求
+        break;
+      }
+      if (ec)
+      {
+        ++errors_;
+        break;
+      }
+      ++retransmitted_;
+      retransmit_tokens_ -= 1;
+    }
+  }
+
+  void do_tick()
+  {
+    next_tick_ += tick_;
+    timer_.expires_at(next_tick_);   //按计划时间排下一个周期，不累积漂移
+    timer_.async_wait(
+        [this](boost::system::error_code ec)
+        {
+          if (ec)
+            return;
+          auto now = std::chrono::steady_clock::now();
+          late_.record(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                now - next_tick_).count());
+          bool sending = options_.seconds == 0
+            || now - start_ < std::chrono::seconds(options_.seconds);
+          refill(now);
+          if (sending)
+            send_tokens();
+          if (reliable())
+            send_retransmits();
+          auto done = std::chrono::steady_clock::now();
+          if (done - next_tick_ >= tick_)   //发送跟不上速率，跳过错过的周期，不连续补发
+          {
+            missed_ticks_ += (done - next_tick_) / tick_;
+            next_tick_ = done - tick_;
+          }
+          if (now >= next_report_)
+          {
+            report(std::cout, sequence_ - last_sent_);
+            late_ = latency_histogram();
+            last_sent_ = sequence_;
+            next_report_ += std::chrono::seconds(1);
+          }
+          if (sending || (reliable() && now - start_ < std::chrono::seconds(options_.seconds)
+                + std::chrono::milliseconds(options_.linger_ms)))
+            do_tick();   //发送结束后再等一会儿，处理最后的NACK
+          else
+          {
+            report(std::cout, 0);
+            io_context_.stop();   //发送完毕，不再等待信号
+          }
+        });
+  }
+
+  void refill(std::chrono::steady_clock::time_point now)  //令牌桶：按实际经过的时间补充
+  {
+    double elapsed = std::chrono::duration<double>(now - last_refill_).count();
+    last_refill_ = now;
+    double burst = static_cast<double>(options_.rate) * options_.tick_us
+      * options_.burst_ticks / 1e6;
+    tokens_ = std::min(tokens_ + options_.rate * elapsed, std::max(burst, 1.0));
+    double retransmit_burst = static_cast<double>(options_.retransmit_rate)
+      * options_.tick_us * options_.burst_ticks / 1e6;
+    retransmit_tokens_ = std::min(retransmit_tokens_ + options_.retransmit_rate * elapsed,
+        std::max(retransmit_burst, 1.0));
+  }
+
+  void send_tokens()  //每批改写报头后一次发出
+  {
+    boost::system::error_code ec;
+    while (tokens_ >= 1)
+    {
+      std::size_t n = static_cast<std::size_t>(tokens_);
+      if (n > batch_.capacity())
+        n = batch_.capacity();
+      feed_header header;
+      header.send_time = feed_header::now();
+      for (std::size_t i = 0; i < n; ++i)
+      {
+        header.sequence = sequence_ + i;
+        header.encode(batch_.data(i));
+      }
+      std::size_t sent = batch_.send(socket_, n, ec);
+      if (reliable())
+      {
+        for (std::size_t i = 0; i < sent; ++i)
+          retransmits_.store(sequence_ + i, batch_.data(i), batch_.length(i));
+      }
+      sequence_ += sent;
+      tokens_ -= sent;
+      if (ec == boost::asio::error::would_block)
+      {
+        ++send_full_;   //令牌留到下个周期
+        break;
+      }
+      if (ec)
+      {
+        ++errors_;
+        break;
+      }
+    }
+  }
+
+  pacing_options options_;
+  boost::asio::io_context& io_context_;
+  boost::asio::ip::udp::socket socket_;
+  boost::asio::steady_timer timer_;
+  packet_batch batch_;
+  retransmit_ring retransmits_;
+  boost::asio::ip::udp::endpoint destination_;
+  std::array<char, nack_message::max_size> nack_buffer_;
+  boost::asio::ip::udp::endpoint nack_sender_;
+  std::vector<nack_range> nack_ranges_;
+  std::chrono::steady_clock::duration tick_;
+  std::chrono::steady_clock::time_point start_;
+  std::chrono::steady_clock::time_point last_refill_;
+  std::chrono::steady_clock::time_point next_tick_;
+  std::chrono::steady_clock::time_point next_report_;
+  double tokens_;
+  double retransmit_tokens_;
+  std::uint64_t sequence_;
+  std::uint64_t last_sent_;
+  std::uint64_t errors_ = 0;
+  std::uint64_t send_full_ = 0;      //发送缓冲区满，停止本周期发送的次数
+  std::uint64_t missed_ticks_ = 0;   //达不到速率时累加
+  std::uint64_t nacks_ = 0;
+  std::uint64_t retransmitted_ = 0;
+  std::uint64_t suppressed_ = 0;     //刚重传过或已在队列里
+  std::uint64_t unavailable_ = 0;    //已不在重传环里
+  std::uint64_t overloaded_ = 0;     //重传队列已满，丢弃的请求
+  latency_histogram late_;   //每个周期定时器晚醒的纳秒数
 };
 
 int main(int argc, char* argv[])
 {
   try
   {
-    if (argc != 2)
+    std::size_t segments = 1;
+    bool paced = false;
+    pacing_options pacing;
+    int arg = 1;
+    for (; arg + 1 < argc && argv[arg][0] == '-'; arg += 2)
+    {
+      if (std::strcmp(argv[arg], "-g") == 0)  //每次发送的消息数，大于1时用GSO
+        segments = std::strtoul(argv[arg + 1], nullptr, 10);
+      else if (std::strcmp(argv[arg], "-r") == 0)  //按速率发送行情，每秒包数
+      {
+        pacing.rate = std::strtoull(argv[arg + 1], nullptr, 10);
+        paced = true;
+      }
+      else if (std::strcmp(argv[arg], "-m") == 0)  //包大小，至少是报头大小
+        pacing.packet_size = std::strtoul(argv[arg + 1], nullptr, 10);
+      else if (std::strcmp(argv[arg], "-D") == 0)  //发送秒数，0为一直发送
+        pacing.seconds = std::strtoul(argv[arg + 1], nullptr, 10);
+      else if (std::strcmp(argv[arg], "-i") == 0)  //定时器周期(微秒)
+        pacing.tick_us = std::strtoul(argv[arg + 1], nullptr, 10);
+      else if (std::strcmp(argv[arg], "-b") == 0)  //一次sendmmsg的包数
+        pacing.batch = std::strtoul(argv[arg + 1], nullptr, 10);
+      else if (std::strcmp(argv[arg], "-B") == 0)  //重传环的包数，0为不重传
+        pacing.retransmit_ring = std::strtoul(argv[arg + 1], nullptr, 10);
+      else if (std::strcmp(argv[arg], "-R") == 0)  //每秒最多重传的包数
+        pacing.retransmit_rate = std::strtoull(argv[arg + 1], nullptr, 10);
+      else
+        break;
+    }
+    if (pacing.packet_size < feed_header::size)
+      pacing.packet_size = feed_header::size;
+    if (pacing.tick_us == 0)
+      pacing.tick_us = 1;
+    if (pacing.batch == 0)
+      pacing.batch = 1;
+    if (arg + 1 != argc)
     {
-      std::cerr << "Usage: sender <multicast_address>\n";
+      std::cerr << "Usage: sender [-g <segments>] <multicast_address>\n";
+      std::cerr << "       sender -r <packets_per_sec> [-m <packet_size>] [-D <seconds>]"
+        " [-i <tick_us>] [-b <batch>] [-B <retransmit_ring>] [-R <retransmits_per_sec>]"
+        " <multicast_address>\n";
       std::cerr << "  For IPv4, try:\n";
       std::cerr << "    sender 239.255.0.1\n";
       std::cerr << "  For IPv6, try:\n";
@@ -69,8 +455,23 @@ int main(int argc, char* argv[])
     }
 
     boost::asio::io_context io_context;
-    sender s(io_context, boost::asio::ip::make_address(argv[1]));
-    io_context.run();
+    if (paced)
+    {
+      paced_sender s(io_context, boost::asio::ip::make_address(argv[arg]), pacing);
+      boost::asio::signal_set signals(io_context, SIGINT, SIGTERM);
+      signals.async_wait(
+          [&](boost::system::error_code /*ec*/, int /*signo*/)
+          {
+            s.report(std::cout, 0);
+            io_context.stop();
+          });
+      io_context.run();
+    }
+    else
+    {
+      sender s(io_context, boost::asio::ip::make_address(argv[arg]), segments);
+      io_context.run();
+    }
   }
   catch (std::exception& e)
   {
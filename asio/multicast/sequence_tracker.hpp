@@ -0,0 +1,129 @@
+//按序号检测一个发送方的丢包、重复和乱序
+//最近window个序号各占一位，记录是否已收到；比窗口还旧的包无法判断，算作过期
+//从收到的第一个包开始计：中途加入时收到更早的包(比如别的接收方要求的重传)也算作过期，不计入缺失
+//发送方重启后一般换了源端口，当作新的发送方，这里不猜测序号是否重新开始
+#ifndef SEQUENCE_TRACKER_HPP
+#define SEQUENCE_TRACKER_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+//--------------------------------
+//missing是当前仍缺的个数：迟到的包补上后会减回去
+class sequence_tracker
+{
+public:
+  enum { default_window = 4096 };   //2的幂
+
+  explicit sequence_tracker(std::size_t window = default_window)
+    : seen_(window / 64 != 0 ? window / 64 : 1),
+      started_(false),
+      first_(0),
+      next_(0),
+      received_(0),
+      missing_(0),
+      duplicates_(0),
+      late_(0),
+      stale_(0)
+  {
+  }
+
+  enum result { in_order, gap, late, duplicate, stale };
+
+  result on_packet(std::uint64_t sequence)
+  {
+    ++received_;
+    if (!started_)   //第一个包，从它开始计
+    {
+      started_ = true;
+      first_ = sequence;
+      next_ = sequence + 1;
+      mark(sequence);
+      return in_order;
+    }
+    if (sequence < first_ || sequence + window() < next_)   //开始计数之前的包，或迟到太久
+    {
+      ++stale_;
+      return stale;
+    }
+    if (sequence == next_)
+    {
+      ++next_;
+      mark(sequence);
+      return in_order;
+    }
+    if (sequence > next_)   //中间缺了一段
+    {
+      std::uint64_t skipped = sequence - next_;
+      for (std::uint64_t s = next_; s < sequence && s < next_ + window(); ++s)
+        clear(s);
+      if (skipped >= window())
+        std::fill(seen_.begin(), seen_.end(), 0);
+      missing_ += skipped;
+      next_ = sequence + 1;
+      mark(sequence);
+      return gap;
+    }
+    //[first_, next_)里的位要么按序收到时置上，要么由上面的缺口清掉，所以清着的位一定是缺口里的包
+    if (sequence + window() >= next_ && !test(sequence))   //窗口内缺的包迟到了
+    {
+      mark(sequence);
+      --missing_;
+      ++late_;
+      return late;
+    }
+    ++duplicates_;
+    return duplicate;
+  }
+
+  std::uint64_t received() const { return received_; }
+  std::uint64_t missing() const { return missing_; }
+  std::uint64_t duplicates() const { return duplicates_; }
+  std::uint64_t late_packets() const { return late_; }
+  std::uint64_t stale_packets() const { return stale_; }
+  std::uint64_t next() const { return next_; }   //期望的下一个序号
+
+  std::uint64_t window() const
+  {
+    return seen_.size() * 64;
+  }
+
+  bool in_window(std::uint64_t s) const  //还能判断收没收到
+  {
+    return started_ && s >= first_ && s < next_ && s + window() >= next_;
+  }
+
+  bool has(std::uint64_t s) const
+  {
+    return in_window(s) && test(s);
+  }
+
+private:
+  void mark(std::uint64_t s)
+  {
+    seen_[(s / 64) % seen_.size()] |= std::uint64_t(1) << (s % 64);
+  }
+
+  void clear(std::uint64_t s)
+  {
+    seen_[(s / 64) % seen_.size()] &= ~(std::uint64_t(1) << (s % 64));
+  }
+
+  bool test(std::uint64_t s) const
+  {
+    return (seen_[(s / 64) % seen_.size()] >> (s % 64)) & 1;
+  }
+
+  std::vector<std::uint64_t> seen_;
+  bool started_;
+  std::uint64_t first_;   //收到的第一个序号
+  std::uint64_t next_;
+  std::uint64_t received_;
+  std::uint64_t missing_;
+  std::uint64_t duplicates_;
+  std::uint64_t late_;
+  std::uint64_t stale_;
+};
+
+#endif // SEQUENCE_TRACKER_HPP
@@ -0,0 +1,89 @@
+//sequence_tracker的检查：乱序、迟到、重复、过期，以及中途加入时收到更早的重传
+//sequence_tracker_test  全部通过时输出ok，返回0
+#include <cstdint>
+#include <cstdio>
+#include "sequence_tracker.hpp"
+
+static int failures = 0;
+
+#define CHECK(expr) \
+  do { if (!(expr)) { std::printf("%s:%d: %s\n", __FILE__, __LINE__, #expr); ++failures; } } while (0)
+
+//----------------------------------------------------------------------
+static void gap_and_late()  //缺的包迟到后补上，missing减回去
+{
+  sequence_tracker t;
+  CHECK(t.on_packet(0) == sequence_tracker::in_order);
+  CHECK(t.on_packet(1) == sequence_tracker::in_order);
+  CHECK(t.on_packet(4) == sequence_tracker::gap);
+  CHECK(t.missing() == 2);
+  CHECK(t.on_packet(3) == sequence_tracker::late);
+  CHECK(t.on_packet(3) == sequence_tracker::duplicate);
+  CHECK(t.on_packet(2) == sequence_tracker::late);
+  CHECK(t.missing() == 0);
+  CHECK(t.late_packets() == 2);
+  CHECK(t.duplicates() == 1);
+  CHECK(t.on_packet(1) == sequence_tracker::duplicate);
+  CHECK(t.missing() == 0);
+}
+
+static void reordered_first_packet()  //前两个包乱序：更早的那个不算缺失也不算迟到
+{
+  sequence_tracker t;
+  CHECK(t.on_packet(5) == sequence_tracker::in_order);
+  CHECK(t.on_packet(4) == sequence_tracker::stale);
+  CHECK(t.missing() == 0);
+  CHECK(t.late_packets() == 0);
+  CHECK(!t.has(4));
+  CHECK(t.on_packet(6) == sequence_tracker::in_order);
+  CHECK(t.missing() == 0);
+}
+
+static void joins_mid_stream()  //中途加入，收到别的接收方要求的重传
+{
+  sequence_tracker t;
+  CHECK(t.on_packet(1000) == sequence_tracker::in_order);
+  CHECK(t.on_packet(1001) == sequence_tracker::in_order);
+  CHECK(t.on_packet(997) == sequence_tracker::stale);
+  CHECK(t.on_packet(998) == sequence_tracker::stale);
+  CHECK(t.on_packet(999) == sequence_tracker::stale);
+  CHECK(t.missing() == 0);
+  CHECK(t.late_packets() == 0);
+  CHECK(t.stale_packets() == 3);
+  CHECK(!t.in_window(999));
+
+  CHECK(t.on_packet(1003) == sequence_tracker::gap);  //加入之后的缺口照常计算
+  CHECK(t.on_packet(999) == sequence_tracker::stale);
+  CHECK(t.missing() == 1);
+  CHECK(t.on_packet(1002) == sequence_tracker::late);
+  CHECK(t.missing() == 0);
+}
+
+static void beyond_window()  //缺口比窗口大：窗口外的只计入missing，再来算作过期
+{
+  sequence_tracker t(64);
+  CHECK(t.on_packet(0) == sequence_tracker::in_order);
+  CHECK(t.on_packet(200) == sequence_tracker::gap);
+  CHECK(t.missing() == 199);
+  CHECK(t.on_packet(100) == sequence_tracker::stale);
+  CHECK(t.on_packet(150) == sequence_tracker::late);
+  CHECK(t.missing() == 198);
+  CHECK(t.on_packet(150) == sequence_tracker::duplicate);
+  CHECK(t.missing() == 198);
+}
+
+int main()
+{
+  gap_and_late();
+  reordered_first_packet();
+  joins_mid_stream();
+  beyond_window();
+
+  if (failures != 0)
+  {
+    std::printf("%d checks failed\n", failures);
+    return 1;
+  }
+  std::printf("ok\n");
+  return 0;
+}
@@ -3,6 +3,7 @@
 #include <iostream>
 #include <boost/asio.hpp>
 #include <boost/asio/ssl.hpp>
+#include "../allocation/thread_cache.hpp"
 
 using boost::asio::ip::tcp;
 //tcp连接对象
@@ -60,7 +61,7 @@ private:
         });
   }
 
-  boost::asio::ssl::stream<tcp::socket> socket_;
+  thread_cached_io<boost::asio::ssl::stream<tcp::socket> > socket_;  //异步操作的处理函数使用线程缓存
   char data_[1024];
 };
 //服务器
@@ -80,7 +81,7 @@ public:
     context_.use_private_key_file("server.pem", boost::asio::ssl::context::pem);//私钥文件
     context_.use_tmp_dh_file("dh2048.pem");   
 
-    do_accept();  /开始监听
+    do_accept();  //开始监听
   }
 
 private:
@@ -92,7 +93,7 @@ private:
   void do_accept()
   {
     acceptor_.async_accept(
-        [this](const boost::system::error_code& error, tcp::socket socket)  异步监听客户端连接
+        [this](const boost::system::error_code& error, tcp::socket socket)  //异步监听客户端连接
         {
           if (!error)
           {
@@ -103,7 +104,7 @@ private:
         });
   }
 
-  tcp::acceptor acceptor_;
+  thread_cached_io<tcp::acceptor> acceptor_;
   boost::asio::ssl::context context_;
 };
 
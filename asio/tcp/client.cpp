@@ -1,34 +1,37 @@
 #include <cstdlib>
-#include <deque>
+#include <cstring>
 #include <iostream>
+#include <string>
 #include <thread>
 #include <boost/asio.hpp>
-#include "chat_message.hpp"
+#include "../chat/chat_frame.hpp"
+#include "../chat/frame_reader.hpp"
+#include "../chat/write_queue.hpp"
 
 using boost::asio::ip::tcp;
 
-typedef std::deque<chat_message> chat_message_queue;
+typedef basic_write_queue<chat_frame> chat_message_queue; //聚合写队列
 //-----------------------------------------------------
 //聊天客户端
 class chat_client
 {
 public:
   chat_client(boost::asio::io_context& io_context,
-      const tcp::resolver::results_type& endpoints)
+      const tcp::resolver::results_type& endpoints, std::size_t max_body_length)
     : io_context_(io_context),
-      socket_(io_context)
+      socket_(io_context),
+      reader_(max_body_length)
   {
     do_connect(endpoints);
   }
 
-  void write(const chat_message& msg)  //写消息
+  void write(const chat_frame& msg)  //写消息
   {
     boost::asio::post(io_context_,
         [this, msg]()
         {
-          bool write_in_progress = !write_msgs_.empty();
-          write_msgs_.push_back(msg);
-          if (!write_in_progress)
+          write_msgs_.push(msg);
+          if (!write_msgs_.writing())
           {
             do_write();
           }
@@ -48,57 +51,43 @@ private:
         {
           if (!ec)
           {
-            do_read_header();
+            do_read();
           }
         });
   }
 
-  void do_read_header()  //读消息头
+  void do_read()  //一次读入大块数据，打印其中所有完整的帧
   {
-    boost::asio::async_read(socket_,
-        boost::asio::buffer(read_msg_.data(), chat_message::header_length),
-        [this](boost::system::error_code ec, std::size_t /*length*/)
-        {
-          if (!ec && read_msg_.decode_header())
-          {
-            do_read_body();
-          }
-          else
-          {
-            socket_.close();
-          }
-        });
-  }
-
-  void do_read_body() //读消息体
-  {
-    boost::asio::async_read(socket_,
-        boost::asio::buffer(read_msg_.body(), read_msg_.body_length()),
-        [this](boost::system::error_code ec, std::size_t /*length*/)
+    socket_.async_read_some(reader_.prepare(),
+        [this](boost::system::error_code ec, std::size_t length)
         {
           if (!ec)
           {
-            std::cout.write(read_msg_.body(), read_msg_.body_length());
-            std::cout << "\n";
-            do_read_header();
-          }
-          else
-          {
-            socket_.close();
+            reader_.commit(length);
+            frame_view f;
+            while (reader_.next(f))
+            {
+              std::cout.write(f.body(), f.body_length);
+              std::cout << "\n";
+            }
+            if (!reader_.bad())
+            {
+              do_read();
+              return;
+            }
           }
+          socket_.close();
         });
   }
 
-  void do_write() //写消息
+  void do_write() //把排队的消息聚合成一次写
   {
-    boost::asio::async_write(socket_,
-        boost::asio::buffer(write_msgs_.front().data(),
-          write_msgs_.front().length()),
+    boost::asio::async_write(socket_, write_msgs_.prepare(),
         [this](boost::system::error_code ec, std::size_t /*length*/)
         {
           if (!ec)
           {
-            write_msgs_.pop_front();
+            write_msgs_.consume();
             if (!write_msgs_.empty())
             {
               do_write();
@@ -114,7 +103,7 @@ private:
 private:
   boost::asio::io_context& io_context_;
   tcp::socket socket_;
-  chat_message read_msg_;
+  frame_reader reader_;
   chat_message_queue write_msgs_;
 };
 
@@ -122,26 +111,35 @@ int main(int argc, char* argv[])
 {
   try
   {
-    if (argc != 3)
+    std::size_t max_body_length = chat_frame::default_max_body_length;
+    int arg = 1;
+    for (; arg + 1 < argc && argv[arg][0] == '-'; arg += 2)
+    {
+      if (std::strcmp(argv[arg], "-l") == 0)  //包体最大长度，与服务器的-l一致
+        max_body_length = std::strtoul(argv[arg + 1], nullptr, 10);
+      else
+        break;
+    }
+    if (argc - arg != 2)
     {
-      std::cerr << "Usage: chat_client <host> <port>\n";
+      std::cerr << "Usage: chat_client [-l <max_body_length>] <host> <port>\n";
       return 1;
     }
 
     boost::asio::io_context io_context;
 
     tcp::resolver resolver(io_context);
-    auto endpoints = resolver.resolve(argv[1], argv[2]);
-    chat_client c(io_context, endpoints);
+    auto endpoints = resolver.resolve(argv[arg], argv[arg + 1]);
+    chat_client c(io_context, endpoints, max_body_length);
 
     std::thread t([&io_context](){ io_context.run(); });
 
-    char line[chat_message::max_body_length + 1];
-    while (std::cin.getline(line, chat_message::max_body_length + 1))  //循环发送消息
+    std::string line;
+    while (std::getline(std::cin, line))  //循环发送消息，超长的行截断
     {
-      chat_message msg;
-      msg.body_length(std::strlen(line));
-      std::memcpy(msg.body(), line, msg.body_length());
+      chat_frame msg(max_body_length);
+      msg.body_length(line.size());
+      std::memcpy(msg.body(), line.data(), msg.body_length());
       msg.encode_header();
       c.write(msg);
     }
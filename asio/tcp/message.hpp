@@ -1,83 +1,9 @@
-//包头+包体，tcp数据需要拆包
+//包头+包体，tcp数据需要拆包。帧格式与chat一致，见chat/chat_frame.hpp
 #ifndef CHAT_MESSAGE_HPP
 #define CHAT_MESSAGE_HPP
 
-#include <cstdio>
-#include <cstdlib>
-#include <cstring>
-//--------------------------------
-//聊天消息  包头+包体，tcp数据需要拆包，包头内容为包体的长度
-class chat_message
-{
-public:
-  enum { header_length = 4 };
-  enum { max_body_length = 512 };
+#include "../chat/chat_frame.hpp"
 
-  chat_message()
-    : body_length_(0)
-  {
-  }
-
-  const char* data() const
-  {
-    return data_;
-  }
-
-  char* data()
-  {
-    return data_;
-  }
-
-  std::size_t length() const
-  {
-    return header_length + body_length_;
-  }
-
-  const char* body() const
-  {
-    return data_ + header_length;
-  }
-
-  char* body()
-  {
-    return data_ + header_length;
-  }
-
-  std::size_t body_length() const
-  {
-    return body_length_;
-  }
-
-  void body_length(std::size_t new_length)
-  {
-    body_length_ = new_length;
-    if (body_length_ > max_body_length)
-      body_length_ = max_body_length;
-  }
-
-  bool decode_header()  //解包头
-  {
-    char header[header_length + 1] = "";
-    std::strncat(header, data_, header_length);
-    body_length_ = std::atoi(header);
-    if (body_length_ > max_body_length)
-    {
-      body_length_ = 0;
-      return false;
-    }
-    return true;
-  }
-
-  void encode_header()  //封装包头
-  {
-    char header[header_length + 1] = "";
-    std::sprintf(header, "%4d", static_cast<int>(body_length_));
-    std::memcpy(data_, header, header_length);
-  }
-
-private:
-  char data_[header_length + max_body_length];
-  std::size_t body_length_;
-};
+typedef chat_frame chat_message;
 
 #endif // CHAT_MESSAGE_HPP
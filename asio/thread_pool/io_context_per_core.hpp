@@ -0,0 +1,156 @@
+//每个核一个io_context：每个线程绑定一个CPU，各自用SO_REUSEPORT监听同一端口
+//内核把新连接分散到各个线程，线程之间不共享任何状态
+#ifndef IO_CONTEXT_PER_CORE_HPP
+#define IO_CONTEXT_PER_CORE_HPP
+
+#include <cstddef>
+#include <iostream>
+#include <memory>
+#include <thread>
+#include <vector>
+#include <boost/asio.hpp>
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+//--------------------------------
+//SO_REUSEPORT选项，asio没有自带
+typedef boost::asio::detail::socket_option::boolean<
+  SOL_SOCKET, SO_REUSEPORT> reuse_port;
+//--------------------------------
+//打开监听socket。reuse为true时多个acceptor可以绑定同一端口
+inline void open_acceptor(boost::asio::ip::tcp::acceptor& acceptor,
+    const boost::asio::ip::tcp::endpoint& endpoint, bool reuse)
+{
+  acceptor.open(endpoint.protocol());
+  acceptor.set_option(boost::asio::ip::tcp::acceptor::reuse_address(true));
+  if (reuse)
+    acceptor.set_option(reuse_port(true));
+  acceptor.bind(endpoint);
+  acceptor.listen();
+}
+//--------------------------------
+//打开并绑定UDP socket。reuse为true时多个socket可以绑定同一端口，内核按来源地址分配数据报
+inline void open_udp_socket(boost::asio::ip::udp::socket& socket,
+    const boost::asio::ip::udp::endpoint& endpoint, bool reuse)
+{
+  socket.open(endpoint.protocol());
+  if (reuse)
+    socket.set_option(reuse_port(true));
+  socket.bind(endpoint);
+}
+//--------------------------------
+//把当前线程绑定到cpu号对应的核上，不支持的平台返回false
+inline bool pin_current_thread(std::size_t cpu)
+{
+#if defined(__linux__)
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  CPU_SET(cpu % CPU_SETSIZE, &set);
+  return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#else
+  (void)cpu;
+  return false;
+#endif
+}
+//--------------------------------
+//打印每个线程的计数及占比，name是计数的名字
+inline void print_distribution(std::ostream& os, const char* name,
+    const std::vector<std::size_t>& counts)
+{
+  std::size_t total = 0;
+  for (std::size_t n: counts)
+    total += n;
+  for (std::size_t i = 0; i < counts.size(); ++i)
+  {
+    os << "thread=" << i << " " << name << "=" << counts[i]
+      << " share=" << (total != 0 ? 100.0 * counts[i] / total : 0.0) << "%\n";
+  }
+}
+
+//打印每个线程接受的连接数
+inline void print_connection_distribution(std::ostream& os,
+    const std::vector<std::size_t>& accepted)
+{
+  print_distribution(os, "connections", accepted);
+}
+//--------------------------------
+//一组io_context，每个只在自己的线程里运行(并发提示为1，省去内部锁)
+//用法：为每个context(i)创建服务器 -> run()阻塞到stop()
+class io_context_per_core
+{
+public:
+  explicit io_context_per_core(std::size_t threads, bool pin)
+    : pin_(pin)
+  {
+    if (threads == 0)
+      threads = default_threads();
+    for (std::size_t i = 0; i < threads; ++i)
+    {
+      contexts_.emplace_back(new boost::asio::io_context(1));
+      work_.push_back(boost::asio::make_work_guard(*contexts_.back()));
+    }
+  }
+
+  io_context_per_core(const io_context_per_core&) = delete;
+  io_context_per_core& operator=(const io_context_per_core&) = delete;
+
+  static std::size_t default_threads()  //每个核一个
+  {
+    std::size_t n = std::thread::hardware_concurrency();
+    return n != 0 ? n : 1;
+  }
+
+  std::size_t size() const
+  {
+    return contexts_.size();
+  }
+
+  boost::asio::io_context& context(std::size_t i)
+  {
+    return *contexts_[i];
+  }
+
+  std::vector<boost::asio::io_context*> contexts()
+  {
+    std::vector<boost::asio::io_context*> result;
+    for (auto& c: contexts_)
+      result.push_back(c.get());
+    return result;
+  }
+
+  //第0个context在调用线程里运行，其余各开一个线程；全部停止后返回
+  void run()
+  {
+    std::vector<std::thread> threads;
+    for (std::size_t i = 1; i < contexts_.size(); ++i)
+    {
+      threads.emplace_back(
+          [this, i]()
+          {
+            if (pin_)
+              pin_current_thread(i % default_threads());  //线程比核多时轮流绑定
+            contexts_[i]->run();
+          });
+    }
+    if (pin_)
+      pin_current_thread(0);
+    contexts_.front()->run();
+    for (auto& t: threads)
+      t.join();
+  }
+
+  void stop()  //可在任意线程调用
+  {
+    for (auto& c: contexts_)
+      c->stop();
+  }
+
+private:
+  std::vector<std::unique_ptr<boost::asio::io_context> > contexts_;
+  std::vector<boost::asio::executor_work_guard<
+    boost::asio::io_context::executor_type> > work_;
+  bool pin_;
+};
+
+#endif // IO_CONTEXT_PER_CORE_HPP
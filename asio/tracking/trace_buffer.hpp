@@ -0,0 +1,249 @@
+//二进制跟踪缓冲区：每个线程一个无锁环形队列，记录是64字节的定长结构，写入只是填结构加一次原子存储
+//后台线程定期把各线程的记录写到文件，遇到新的字符串指针时先写一条字符串定义，离线工具据此还原文本
+//队列满时丢弃新记录并计数，记录线程永远不会阻塞
+#ifndef TRACE_BUFFER_HPP
+#define TRACE_BUFFER_HPP
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+//--------------------------------
+//文件由连续的trace_record组成。各字段的含义取决于type，见custom_tracking.hpp
+struct trace_record
+{
+  enum record_type : std::uint16_t
+  {
+    string_def = 1,           //a=字符串指针，text()是内容(截断到39字节)
+    creation,                 //a=handler b=tree c=parent d=native_handle object op
+    invocation_begin,         //a=handler b=tree
+    invocation_end,           //a=handler b=tree value=1表示handler抛出异常退出
+    operation,                //c=native_handle object op
+    reactor_registration,     //a=registration c=native_handle
+    reactor_deregistration,   //a=registration c=native_handle
+    reactor_events,           //a=registration d=events
+    reactor_operation,        //a=handler b=ec类别名 c=native_handle d=bytes(全1表示没有) object op value=ec
+    dropped                   //d=队列满丢弃的记录数
+  };
+
+  std::uint64_t time;         //steady_clock纳秒
+  std::uint64_t a;
+  std::uint64_t b;
+  std::uint64_t c;
+  std::uint64_t d;
+  std::uint64_t object;       //const char*，对应string_def
+  std::uint64_t op;           //const char*
+  std::uint16_t type;
+  std::uint16_t thread;       //线程序号，按第一次记录的先后编号
+  std::int32_t value;
+
+  enum { max_text = 39 };
+
+  const char* text() const  //string_def的内容放在b到op这40字节里
+  {
+    return reinterpret_cast<const char*>(this) + offsetof(trace_record, b);
+  }
+};
+static_assert(sizeof(trace_record) == 64, "trace_record must stay 64 bytes");
+//--------------------------------
+//一个线程的记录队列：所在线程是唯一的生产者，刷新线程是唯一的消费者
+class trace_ring
+{
+public:
+  enum { capacity = 1 << 16 };   //每个线程4MB
+
+  explicit trace_ring(std::uint16_t thread)
+    : records_(capacity),
+      thread_(thread),
+      head_(0),
+      tail_(0),
+      dropped_(0)
+  {
+  }
+
+  std::uint16_t thread() const
+  {
+    return thread_;
+  }
+
+  //生产者：取下一个空位，满了返回nullptr；填好后调用commit()
+  trace_record* prepare()
+  {
+    std::size_t tail = tail_.load(std::memory_order_relaxed);
+    if (tail - cached_head_ == capacity)
+      cached_head_ = head_.load(std::memory_order_acquire);   //看起来满了才读消费者的下标
+    if (tail - cached_head_ == capacity)
+    {
+      dropped_.store(dropped_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+      return nullptr;
+    }
+    return &records_[tail & (capacity - 1)];
+  }
+
+  void commit()
+  {
+    tail_.store(tail_.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+  }
+
+  //消费者：把已提交的记录依次交给f，返回个数
+  template <typename F>
+  std::size_t drain(F f)
+  {
+    std::size_t head = head_.load(std::memory_order_relaxed);
+    std::size_t tail = tail_.load(std::memory_order_acquire);
+    for (std::size_t i = head; i != tail; ++i)
+      f(records_[i & (capacity - 1)]);
+    head_.store(tail, std::memory_order_release);
+    return tail - head;
+  }
+
+  std::uint64_t take_dropped()  //自上次以来丢弃的记录数
+  {
+    std::uint64_t d = dropped_.load(std::memory_order_relaxed);
+    std::uint64_t n = d - reported_dropped_;
+    reported_dropped_ = d;
+    return n;
+  }
+
+private:
+  std::vector<trace_record> records_;
+  std::uint16_t thread_;
+  alignas(64) std::atomic<std::size_t> head_;
+  alignas(64) std::atomic<std::size_t> tail_;
+  std::size_t cached_head_ = 0;          //生产者看到的head_
+  std::atomic<std::uint64_t> dropped_;
+  std::uint64_t reported_dropped_ = 0;   //只有消费者用
+};
+//--------------------------------
+//全局：登记各线程的队列，后台线程每10毫秒把记录写到文件
+//文件名取环境变量ASIO_TRACE_FILE，默认asio_trace.bin
+class trace_buffer
+{
+public:
+  static trace_buffer& instance()
+  {
+    static trace_buffer b;
+    return b;
+  }
+
+  void start()  //可重复调用
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (flusher_.joinable())
+      return;
+    const char* path = std::getenv("ASIO_TRACE_FILE");
+    file_ = std::fopen(path ? path : "asio_trace.bin", "wb");
+    if (!file_)
+      return;
+    stopping_ = false;
+    flusher_ = std::thread([this]() { run(); });
+  }
+
+  //当前线程的队列，第一次调用时登记
+  trace_ring& ring()
+  {
+    thread_local std::shared_ptr<trace_ring> ring = add_ring();
+    return *ring;
+  }
+
+  static std::uint64_t now()
+  {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+  }
+
+  ~trace_buffer()
+  {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stopping_ = true;
+    }
+    wakeup_.notify_one();
+    if (flusher_.joinable())
+      flusher_.join();   //最后一次刷新后才关闭文件
+    if (file_)
+      std::fclose(file_);
+  }
+
+private:
+  trace_buffer() = default;
+
+  std::shared_ptr<trace_ring> add_ring()
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    rings_.push_back(std::make_shared<trace_ring>(static_cast<std::uint16_t>(rings_.size())));
+    return rings_.back();
+  }
+
+  void run()  //刷新线程
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    for (;;)
+    {
+      bool stopping = wakeup_.wait_for(lock, std::chrono::milliseconds(10),
+          [this]() { return stopping_; });
+      std::vector<std::shared_ptr<trace_ring> > rings(rings_);
+      lock.unlock();
+      for (auto& r: rings)
+        flush(*r);
+      std::fflush(file_);
+      lock.lock();
+      if (stopping)
+        break;
+    }
+  }
+
+  void flush(trace_ring& r)
+  {
+    r.drain(
+        [this](const trace_record& rec)
+        {
+          define(rec.object);
+          define(rec.op);
+          if (rec.type == trace_record::reactor_operation)
+            define(rec.b);   //ec类别名
+          std::fwrite(&rec, sizeof(rec), 1, file_);
+        });
+    if (std::uint64_t n = r.take_dropped())
+    {
+      trace_record rec = trace_record();
+      rec.time = now();
+      rec.type = trace_record::dropped;
+      rec.thread = r.thread();
+      rec.d = n;
+      std::fwrite(&rec, sizeof(rec), 1, file_);
+    }
+  }
+
+  void define(std::uint64_t pointer)  //每个字符串指针第一次出现时写出内容
+  {
+    if (pointer == 0 || !strings_.insert(pointer).second)
+      return;
+    trace_record rec = trace_record();
+    rec.type = trace_record::string_def;
+    rec.a = pointer;
+    const char* text = reinterpret_cast<const char*>(pointer);
+    std::memcpy(reinterpret_cast<char*>(&rec) + offsetof(trace_record, b),
+        text, ::strnlen(text, trace_record::max_text));
+    std::fwrite(&rec, sizeof(rec), 1, file_);
+  }
+
+  std::mutex mutex_;   //保护rings_和stopping_
+  std::condition_variable wakeup_;
+  std::vector<std::shared_ptr<trace_ring> > rings_;   //线程退出后队列留到程序结束
+  bool stopping_ = false;
+  std::thread flusher_;
+  std::FILE* file_ = nullptr;
+  std::unordered_set<std::uint64_t> strings_;   //只有刷新线程用
+};
+
+#endif // TRACE_BUFFER_HPP
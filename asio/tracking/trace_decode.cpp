@@ -0,0 +1,302 @@
+//离线解码custom_tracking.hpp写出的二进制跟踪文件
+//trace_decode [-e] [-t <tree_id>] <file>
+//默认按tree_id把handler还原成树，子节点是在父handler运行期间创建的；-e按时间顺序打印每条记录
+#include <algorithm>
+#include <cinttypes>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "trace_buffer.hpp"
+
+//----------------------------------------------------------------------
+struct handler_node
+{
+  std::uint64_t id = 0;
+  std::uint64_t tree = 0;
+  std::uint64_t parent = 0;
+  std::uint64_t native_handle = 0;
+  std::string object;
+  std::string op;
+  std::uint64_t created = 0;
+  std::uint64_t begin = 0;    //0表示没有被调用
+  std::uint64_t end = 0;
+  int thread = -1;            //调用所在的线程
+  bool threw = false;         //handler抛出异常退出
+  std::string result;         //reactor上执行的结果
+  std::vector<std::uint64_t> children;
+};
+//----------------------------------------------------------------------
+class trace_file
+{
+public:
+  bool load(const char* path)
+  {
+    std::FILE* f = std::fopen(path, "rb");
+    if (!f)
+      return false;
+    trace_record r;
+    while (std::fread(&r, sizeof(r), 1, f) == 1)
+    {
+      if (r.type == trace_record::string_def)
+      {
+        char text[trace_record::max_text + 1];
+        std::memcpy(text, r.text(), trace_record::max_text);
+        text[trace_record::max_text] = '\0';
+        strings_[r.a] = text;
+      }
+      else
+      {
+        records_.push_back(r);
+      }
+    }
+    std::fclose(f);
+    //各线程的队列分别写出，合并后按时间排序
+    std::stable_sort(records_.begin(), records_.end(),
+        [](const trace_record& x, const trace_record& y) { return x.time < y.time; });
+    origin_ = records_.empty() ? 0 : records_.front().time;
+    return true;
+  }
+
+  //-e：每条记录一行，格式与原来的printf输出一致，前面加上时间和线程
+  void print_events() const
+  {
+    for (const trace_record& r: records_)
+    {
+      std::printf("@%.3fus t%u ", micros(r.time), r.thread);
+      switch (r.type)
+      {
+      case trace_record::creation:
+        std::printf("Starting operation %s.%s for native_handle = %" PRIu64
+            ", handler = %" PRIu64 ", tree = %" PRIu64 ", parent = %" PRIu64 "\n",
+            str(r.object), str(r.op), r.d, r.a, r.b, r.c);
+        break;
+      case trace_record::invocation_begin:
+        std::printf("Entering handler %" PRIu64 " in tree %" PRIu64 "\n", r.a, r.b);
+        break;
+      case trace_record::invocation_end:
+        std::printf("Leaving handler %" PRIu64 " in tree %" PRIu64 "%s\n", r.a, r.b,
+            r.value ? " by exception" : "");
+        break;
+      case trace_record::operation:
+        std::printf("Operation %s.%s for native_handle = %" PRIu64 "\n",
+            str(r.object), str(r.op), r.c);
+        break;
+      case trace_record::reactor_registration:
+        std::printf("Adding to reactor native_handle = %" PRIu64
+            ", registration = %" PRIu64 "\n", r.c, r.a);
+        break;
+      case trace_record::reactor_deregistration:
+        std::printf("Removing from reactor native_handle = %" PRIu64
+            ", registration = %" PRIu64 "\n", r.c, r.a);
+        break;
+      case trace_record::reactor_events:
+        std::printf("Reactor readiness for registration = %" PRIu64 ", events =%s%s%s\n",
+            r.a, (r.d & 1) ? " read" : "", (r.d & 2) ? " write" : "",
+            (r.d & 4) ? " error" : "");
+        break;
+      case trace_record::reactor_operation:
+        std::printf("Performed operation %s.%s for native_handle = %" PRIu64
+            ", handler = %" PRIu64 ", ec = %s:%d", str(r.object), str(r.op), r.c, r.a,
+            str(r.b), r.value);
+        if (r.d != ~std::uint64_t(0))
+          std::printf(", n = %" PRIu64, r.d);
+        std::printf("\n");
+        break;
+      case trace_record::dropped:
+        std::printf("Dropped %" PRIu64 " records (ring full)\n", r.d);
+        break;
+      default:
+        std::printf("Unknown record type %u\n", r.type);
+        break;
+      }
+    }
+  }
+
+  //按tree_id分组，用创建时记录的父handler连成树
+  void print_trees(std::uint64_t only_tree) const
+  {
+    std::map<std::uint64_t, handler_node> nodes;
+    std::uint64_t dropped = 0;
+    for (const trace_record& r: records_)
+    {
+      switch (r.type)
+      {
+      case trace_record::creation:
+        {
+          handler_node& n = nodes[r.a];
+          n.id = r.a;
+          n.tree = r.b;
+          n.parent = r.c;
+          n.native_handle = r.d;
+          n.object = str(r.object);
+          n.op = str(r.op);
+          n.created = r.time;
+        }
+        break;
+      case trace_record::invocation_begin:
+        if (nodes.count(r.a) && nodes[r.a].begin == 0)
+        {
+          nodes[r.a].begin = r.time;
+          nodes[r.a].thread = r.thread;
+        }
+        break;
+      case trace_record::invocation_end:
+        if (nodes.count(r.a))
+        {
+          nodes[r.a].end = r.time;
+          nodes[r.a].threw = r.value != 0;
+        }
+        break;
+      case trace_record::reactor_operation:
+        if (nodes.count(r.a))
+        {
+          char buffer[96];
+          if (r.d != ~std::uint64_t(0))
+            std::snprintf(buffer, sizeof(buffer), "%s:%d n=%" PRIu64, str(r.b), r.value, r.d);
+          else
+            std::snprintf(buffer, sizeof(buffer), "%s:%d", str(r.b), r.value);
+          nodes[r.a].result = buffer;
+        }
+        break;
+      case trace_record::dropped:
+        dropped += r.d;
+        break;
+      }
+    }
+
+    //父handler不在文件里(被丢弃或在开始记录之前)的当作根
+    std::map<std::uint64_t, std::vector<std::uint64_t> > roots;
+    for (auto& p: nodes)
+    {
+      handler_node& n = p.second;
+      auto parent = nodes.find(n.parent);
+      if (n.parent != 0 && parent != nodes.end())
+        parent->second.children.push_back(n.id);
+      else
+        roots[n.tree].push_back(n.id);
+    }
+
+    std::size_t trees = 0;
+    for (auto& t: roots)
+    {
+      if (only_tree != 0 && t.first != only_tree)
+        continue;
+      ++trees;
+      print_tree(nodes, t.first, t.second);
+    }
+    std::printf("records=%zu handlers=%zu trees=%zu dropped=%" PRIu64 "\n",
+        records_.size(), nodes.size(), trees, dropped);
+  }
+
+private:
+  //异步调用链往往很长，只有一个子节点时不缩进，分叉时才缩进；用显式栈避免递归太深
+  void print_tree(const std::map<std::uint64_t, handler_node>& nodes,
+      std::uint64_t tree, const std::vector<std::uint64_t>& roots) const
+  {
+    std::size_t count = 0;
+    std::uint64_t ran = 0;
+    std::vector<std::pair<std::uint64_t, int> > stack;
+    for (auto it = roots.rbegin(); it != roots.rend(); ++it)
+      stack.emplace_back(*it, 1);
+    std::string lines;
+    while (!stack.empty())
+    {
+      std::uint64_t id = stack.back().first;
+      int depth = stack.back().second;
+      stack.pop_back();
+      const handler_node& n = nodes.at(id);
+      ++count;
+      if (n.begin != 0 && n.end >= n.begin)
+        ran += n.end - n.begin;
+      print_node(n, depth, lines);
+      int child_depth = n.children.size() > 1 ? depth + 1 : depth;
+      for (auto it = n.children.rbegin(); it != n.children.rend(); ++it)
+        stack.emplace_back(*it, child_depth);
+    }
+    std::printf("tree %" PRIu64 " handlers=%zu ran=%.3fus\n%s", tree, count, ran / 1000.0,
+        lines.c_str());
+  }
+
+  void print_node(const handler_node& n, int depth, std::string& out) const
+  {
+    char line[256];
+    int len = std::snprintf(line, sizeof(line), "%*shandler %" PRIu64 " %s.%s fd=%" PRIu64
+        " created=%.3fus", depth * 2, "", n.id, n.object.c_str(), n.op.c_str(),
+        n.native_handle, micros(n.created));
+    out.append(line, std::min<std::size_t>(len, sizeof(line) - 1));
+    if (n.begin != 0)
+    {
+      std::snprintf(line, sizeof(line), " waited=%.3fus", (n.begin - n.created) / 1000.0);
+      out += line;
+      if (n.end >= n.begin)
+      {
+        std::snprintf(line, sizeof(line), " ran=%.3fus", (n.end - n.begin) / 1000.0);
+        out += line;
+      }
+      std::snprintf(line, sizeof(line), " thread=%d", n.thread);
+      out += line;
+      if (n.threw)
+        out += " exception";
+    }
+    else
+    {
+      out += " not_invoked";
+    }
+    if (!n.result.empty())
+      out += " result=" + n.result;
+    out += '\n';
+  }
+
+  double micros(std::uint64_t time) const  //相对第一条记录
+  {
+    return (time - origin_) / 1000.0;
+  }
+
+  const char* str(std::uint64_t pointer) const
+  {
+    auto it = strings_.find(pointer);
+    return it != strings_.end() ? it->second.c_str() : "?";
+  }
+
+  std::unordered_map<std::uint64_t, std::string> strings_;
+  std::vector<trace_record> records_;
+  std::uint64_t origin_ = 0;
+};
+
+int main(int argc, char* argv[])
+{
+  bool events = false;
+  std::uint64_t tree = 0;
+  int arg = 1;
+  for (; arg < argc && argv[arg][0] == '-'; ++arg)
+  {
+    if (std::strcmp(argv[arg], "-e") == 0)  //按时间打印每条记录
+      events = true;
+    else if (std::strcmp(argv[arg], "-t") == 0 && arg + 1 < argc)  //只打印一棵树
+      tree = std::strtoull(argv[++arg], nullptr, 10);
+    else
+      break;
+  }
+  if (arg + 1 != argc)
+  {
+    std::fprintf(stderr, "Usage: trace_decode [-e] [-t <tree_id>] <file>\n");
+    return 1;
+  }
+
+  trace_file file;
+  if (!file.load(argv[arg]))
+  {
+    std::fprintf(stderr, "Cannot open %s\n", argv[arg]);
+    return 1;
+  }
+  if (events)
+    file.print_events();
+  else
+    file.print_trees(tree);
+  return 0;
+}
@@ -0,0 +1,181 @@
+//批量收发数据报：Linux上用recvmmsg/sendmmsg一次系统调用处理一批，其他平台逐个收发
+//数据报缓冲区、地址、消息头都预先分配，收发过程中不分配内存
+#ifndef PACKET_BATCH_HPP
+#define PACKET_BATCH_HPP
+
+#include <cstddef>
+#include <vector>
+#include <boost/asio.hpp>
+#if defined(__linux__)
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <cerrno>
+#endif
+//--------------------------------
+//用法：等待可读 -> n = receive(socket) -> 处理第0到n-1个数据报 -> send(socket, n)原地回复
+//socket设为non_blocking时send不会阻塞：发送缓冲区满就返回已发出的个数、ec为would_block，
+//调用方async_wait(wait_write)后用send(socket, first, count)发出剩下的，期间不能再receive
+class packet_batch
+{
+public:
+  typedef boost::asio::ip::udp udp;
+
+  packet_batch(std::size_t capacity, std::size_t packet_size)
+    : packet_size_(packet_size),
+      buffer_(capacity * packet_size),
+      lengths_(capacity),
+      endpoints_(capacity)
+  {
+#if defined(__linux__)
+    iovecs_.resize(capacity);
+    headers_.resize(capacity);
+#endif
+  }
+
+  packet_batch(const packet_batch&) = delete;
+  packet_batch& operator=(const packet_batch&) = delete;
+
+  std::size_t capacity() const
+  {
+    return lengths_.size();
+  }
+
+  std::size_t packet_size() const
+  {
+    return packet_size_;
+  }
+
+  char* data(std::size_t i)
+  {
+    return buffer_.data() + i * packet_size_;
+  }
+
+  std::size_t length(std::size_t i) const
+  {
+    return lengths_[i];
+  }
+
+  void length(std::size_t i, std::size_t n)  //回复前修改长度
+  {
+    lengths_[i] = n;
+  }
+
+  udp::endpoint& endpoint(std::size_t i)  //收到时是发送方，发送时是目的地址
+  {
+    return endpoints_[i];
+  }
+
+  //不阻塞地收最多capacity()个数据报，没有数据时返回0、ec为would_block
+  std::size_t receive(udp::socket& socket, boost::system::error_code& ec)
+  {
+    ec = boost::system::error_code();
+#if defined(__linux__)
+    for (std::size_t i = 0; i < capacity(); ++i)
+    {
+      iovecs_[i].iov_base = data(i);
+      iovecs_[i].iov_len = packet_size_;
+      msghdr& h = headers_[i].msg_hdr;
+      h = msghdr();
+      h.msg_name = endpoints_[i].data();
+      h.msg_namelen = static_cast<socklen_t>(endpoints_[i].capacity());
+      h.msg_iov = &iovecs_[i];
+      h.msg_iovlen = 1;
+    }
+    int n = ::recvmmsg(socket.native_handle(), headers_.data(),
+        static_cast<unsigned int>(capacity()), MSG_DONTWAIT, nullptr);
+    if (n < 0)
+    {
+      ec = boost::system::error_code(errno, boost::asio::error::get_system_category());
+      if (ec == boost::asio::error::try_again)
+        ec = boost::asio::error::would_block;
+      return 0;
+    }
+    for (int i = 0; i < n; ++i)
+    {
+      lengths_[i] = headers_[i].msg_len;
+      endpoints_[i].resize(headers_[i].msg_hdr.msg_namelen);
+    }
+    return static_cast<std::size_t>(n);
+#else
+    bool blocking = !socket.non_blocking();
+    socket.non_blocking(true);
+    std::size_t n = 0;
+    while (n < capacity())
+    {
+      lengths_[n] = socket.receive_from(
+          boost::asio::buffer(data(n), packet_size_), endpoints_[n], 0, ec);
+      if (ec)
+        break;
+      ++n;
+    }
+    if (blocking)
+      socket.non_blocking(false);
+    if (n != 0)
+      ec = boost::system::error_code();
+    return n;
+#endif
+  }
+
+  //把第0到count-1个数据报发往各自的endpoint()，返回发出的个数
+  std::size_t send(udp::socket& socket, std::size_t count, boost::system::error_code& ec)
+  {
+    return send(socket, 0, count, ec);
+  }
+
+  //发出第first到count-1个数据报，返回发出的个数
+  std::size_t send(udp::socket& socket, std::size_t first, std::size_t count,
+      boost::system::error_code& ec)
+  {
+    ec = boost::system::error_code();
+#if defined(__linux__)
+    for (std::size_t i = first; i < count; ++i)
+    {
+      iovecs_[i].iov_base = data(i);
+      iovecs_[i].iov_len = lengths_[i];
+      msghdr& h = headers_[i].msg_hdr;
+      h = msghdr();
+      h.msg_name = endpoints_[i].data();
+      h.msg_namelen = static_cast<socklen_t>(endpoints_[i].size());
+      h.msg_iov = &iovecs_[i];
+      h.msg_iovlen = 1;
+    }
+    std::size_t sent = 0;
+    while (first + sent < count)
+    {
+      int n = ::sendmmsg(socket.native_handle(), headers_.data() + first + sent,
+          static_cast<unsigned int>(count - first - sent), 0);
+      if (n < 0)
+      {
+        ec = boost::system::error_code(errno, boost::asio::error::get_system_category());
+        if (ec == boost::asio::error::try_again)
+          ec = boost::asio::error::would_block;   //发送缓冲区满，剩下的由调用方等待可写后再发
+        break;
+      }
+      sent += static_cast<std::size_t>(n);
+    }
+    return sent;
+#else
+    std::size_t sent = 0;
+    for (; first + sent < count; ++sent)
+    {
+      socket.send_to(boost::asio::buffer(data(first + sent), lengths_[first + sent]),
+          endpoints_[first + sent], 0, ec);
+      if (ec)
+        break;
+    }
+    return sent;
+#endif
+  }
+
+private:
+  std::size_t packet_size_;
+  std::vector<char> buffer_;   //capacity个packet_size大小的槽位
+  std::vector<std::size_t> lengths_;
+  std::vector<udp::endpoint> endpoints_;
+#if defined(__linux__)
+  std::vector<iovec> iovecs_;
+  std::vector<mmsghdr> headers_;
+#endif
+};
+
+#endif // PACKET_BATCH_HPP
@@ -0,0 +1,202 @@
+//单生产者单消费者的数据报环形队列：槽位预先分配，生产者用recvmmsg直接收进空闲槽位，消费者在另一个线程处理
+//只用两个原子下标，不加锁；两边各自缓存对方的下标，只有看起来满/空时才去读对方的缓存行
+#ifndef PACKET_RING_HPP
+#define PACKET_RING_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <boost/asio.hpp>
+#if defined(__linux__)
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <cerrno>
+#endif
+//--------------------------------
+//生产者：n = receive(socket, now) 或 填写at(write_index()+i)后publish(n)
+//消费者：for (i < readable()) 处理at(read_index()+i) -> release(n)
+class packet_ring
+{
+public:
+  typedef boost::asio::ip::udp udp;
+
+  struct slot
+  {
+    char* data;
+    std::size_t length;
+    std::uint64_t receive_time;   //纳秒，由生产者填写
+    udp::endpoint sender;
+  };
+
+  //capacity取整到2的幂
+  packet_ring(std::size_t capacity, std::size_t slot_size)
+    : slot_size_(slot_size),
+      buffer_(round_up(capacity) * slot_size),
+      slots_(round_up(capacity)),
+      mask_(round_up(capacity) - 1),
+      head_(0),
+      cached_tail_(0),
+      tail_(0),
+      cached_head_(0)
+  {
+    for (std::size_t i = 0; i < slots_.size(); ++i)
+    {
+      slots_[i].data = buffer_.data() + i * slot_size_;
+      slots_[i].length = 0;
+      slots_[i].receive_time = 0;
+    }
+#if defined(__linux__)
+    iovecs_.resize(slots_.size());
+    headers_.resize(slots_.size());
+#endif
+  }
+
+  packet_ring(const packet_ring&) = delete;
+  packet_ring& operator=(const packet_ring&) = delete;
+
+  std::size_t capacity() const
+  {
+    return slots_.size();
+  }
+
+  std::size_t slot_size() const
+  {
+    return slot_size_;
+  }
+
+  slot& at(std::size_t index)  //index是不断增长的位置，内部取模
+  {
+    return slots_[index & mask_];
+  }
+
+  //---------------- 生产者 ----------------
+  std::size_t write_index() const
+  {
+    return tail_.load(std::memory_order_relaxed);
+  }
+
+  std::size_t writable()  //从write_index()开始连续(不绕回)的空闲槽位数
+  {
+    std::size_t tail = tail_.load(std::memory_order_relaxed);
+    if (tail - cached_head_ == slots_.size())
+      cached_head_ = head_.load(std::memory_order_acquire);
+    std::size_t free = slots_.size() - (tail - cached_head_);
+    std::size_t to_end = slots_.size() - (tail & mask_);
+    return free < to_end ? free : to_end;
+  }
+
+  void publish(std::size_t n)
+  {
+    tail_.store(tail_.load(std::memory_order_relaxed) + n, std::memory_order_release);
+  }
+
+  //不阻塞地收最多writable()个数据报到空闲槽位并发布，返回个数；now()返回收到的时间
+  //没有数据时返回0、ec为would_block；队列满时返回0、ec为空
+  template <typename Now>
+  std::size_t receive(udp::socket& socket, Now now, boost::system::error_code& ec)
+  {
+    ec = boost::system::error_code();
+    std::size_t count = writable();
+    if (count == 0)
+      return 0;
+    std::size_t first = write_index();
+#if defined(__linux__)
+    for (std::size_t i = 0; i < count; ++i)
+    {
+      slot& s = at(first + i);
+      iovecs_[i].iov_base = s.data;
+      iovecs_[i].iov_len = slot_size_;
+      msghdr& h = headers_[i].msg_hdr;
+      h = msghdr();
+      h.msg_name = s.sender.data();
+      h.msg_namelen = static_cast<socklen_t>(s.sender.capacity());
+      h.msg_iov = &iovecs_[i];
+      h.msg_iovlen = 1;
+    }
+    int n = ::recvmmsg(socket.native_handle(), headers_.data(),
+        static_cast<unsigned int>(count), MSG_DONTWAIT, nullptr);
+    if (n < 0)
+    {
+      ec = boost::system::error_code(errno, boost::asio::error::get_system_category());
+      if (ec == boost::asio::error::try_again)
+        ec = boost::asio::error::would_block;
+      return 0;
+    }
+    std::uint64_t time = now();
+    for (int i = 0; i < n; ++i)
+    {
+      slot& s = at(first + i);
+      s.length = headers_[i].msg_len;
+      s.receive_time = time;
+      s.sender.resize(headers_[i].msg_hdr.msg_namelen);
+    }
+    std::size_t received = static_cast<std::size_t>(n);
+#else
+    bool blocking = !socket.non_blocking();
+    socket.non_blocking(true);
+    std::size_t received = 0;
+    while (received < count)
+    {
+      slot& s = at(first + received);
+      s.length = socket.receive_from(
+          boost::asio::buffer(s.data, slot_size_), s.sender, 0, ec);
+      if (ec)
+        break;
+      s.receive_time = now();
+      ++received;
+    }
+    if (blocking)
+      socket.non_blocking(false);
+    if (received != 0)
+      ec = boost::system::error_code();
+#endif
+    publish(received);
+    return received;
+  }
+
+  //---------------- 消费者 ----------------
+  std::size_t read_index() const
+  {
+    return head_.load(std::memory_order_relaxed);
+  }
+
+  std::size_t readable()  //可处理的槽位数
+  {
+    std::size_t head = head_.load(std::memory_order_relaxed);
+    if (cached_tail_ == head)
+      cached_tail_ = tail_.load(std::memory_order_acquire);
+    return cached_tail_ - head;
+  }
+
+  void release(std::size_t n)  //处理完的槽位还给生产者
+  {
+    head_.store(head_.load(std::memory_order_relaxed) + n, std::memory_order_release);
+  }
+
+private:
+  static std::size_t round_up(std::size_t n)
+  {
+    std::size_t p = 1;
+    while (p < n)
+      p <<= 1;
+    return p;
+  }
+
+  std::size_t slot_size_;
+  std::vector<char> buffer_;
+  std::vector<slot> slots_;
+  std::size_t mask_;
+#if defined(__linux__)
+  std::vector<iovec> iovecs_;     //只有生产者用
+  std::vector<mmsghdr> headers_;
+#endif
+
+  //消费者写head_，生产者写tail_，分开放在不同的缓存行
+  alignas(64) std::atomic<std::size_t> head_;
+  std::size_t cached_tail_;       //消费者看到的tail_
+  alignas(64) std::atomic<std::size_t> tail_;
+  std::size_t cached_head_;       //生产者看到的head_
+};
+
+#endif // PACKET_RING_HPP
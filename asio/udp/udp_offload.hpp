@@ -0,0 +1,261 @@
+//UDP分段卸载：GSO一次sendmsg发出多个等长数据报，GRO一次recvmsg收到合并后的大包
+//内核(或网卡)负责拆分/合并，每个数据报的系统调用和协议栈开销分摊到整批上
+//不支持的平台或内核退回逐个收发，调用方不需要区分
+#ifndef UDP_OFFLOAD_HPP
+#define UDP_OFFLOAD_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#include <boost/asio.hpp>
+#if defined(__linux__)
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <netinet/in.h>
+#include <netinet/udp.h>
+#include <cerrno>
+#endif
+#if defined(__linux__) && defined(UDP_SEGMENT) && defined(UDP_GRO)
+#define UDP_OFFLOAD_SUPPORTED 1
+#endif
+//--------------------------------
+//GSO发送：send(data, size, segment_size)把data按segment_size切成多个数据报发给同一目的地址
+//最后一段可以比segment_size短
+//socket设为non_blocking时send不会阻塞：发送缓冲区满就返回已发出的数据报数、ec为would_block，
+//调用方async_wait(wait_write)后从data + 已发出数 * segment_size继续
+class segment_sender
+{
+public:
+  typedef boost::asio::ip::udp udp;
+
+  enum { max_segments = 64 };          //内核一次最多拆出的段数
+  enum { max_payload = 65000 };        //一次sendmsg的负载上限，要装进一个IP包的长度字段
+
+  explicit segment_sender(bool offload = true)
+#if defined(UDP_OFFLOAD_SUPPORTED)
+    : offload_(offload)
+#else
+    : offload_(false)
+#endif
+  {
+    (void)offload;
+  }
+
+  bool offload() const  //false表示退回了逐个发送
+  {
+    return offload_;
+  }
+
+  //全部发出、出错或发送缓冲区满时返回，返回发出的数据报数
+  std::size_t send(udp::socket& socket, const udp::endpoint& destination,
+      const char* data, std::size_t size, std::size_t segment_size,
+      boost::system::error_code& ec)
+  {
+    ec = boost::system::error_code();
+    std::size_t sent = 0;
+    std::size_t per_call = segments_per_call(segment_size);
+    while (size != 0 && !ec)
+    {
+      std::size_t chunk = per_call * segment_size < size ? per_call * segment_size : size;
+      std::size_t segments = (chunk + segment_size - 1) / segment_size;
+#if defined(UDP_OFFLOAD_SUPPORTED)
+      if (offload_ && segments > 1)
+      {
+        if (send_gso(socket, destination, data, chunk, segment_size, ec))
+        {
+          sent += segments;
+          data += chunk;
+          size -= chunk;
+          continue;
+        }
+        if (ec)
+          break;
+        offload_ = false;  //内核或网卡不支持，以后都逐个发送
+      }
+#endif
+      for (std::size_t i = 0; i < segments && !ec; ++i)
+      {
+        std::size_t n = segment_size < size ? segment_size : size;
+        socket.send_to(boost::asio::buffer(data, n), destination, 0, ec);
+        if (!ec)
+        {
+          ++sent;
+          data += n;
+          size -= n;
+        }
+      }
+    }
+    return sent;
+  }
+
+private:
+  std::size_t segments_per_call(std::size_t segment_size) const
+  {
+    if (!offload_ || segment_size == 0)
+      return 1;
+    std::size_t n = max_payload / segment_size;
+    if (n > max_segments)
+      n = max_segments;
+    return n != 0 ? n : 1;
+  }
+
+#if defined(UDP_OFFLOAD_SUPPORTED)
+  //成功返回true；返回false且ec为空表示不支持GSO
+  bool send_gso(udp::socket& socket, const udp::endpoint& destination,
+      const char* data, std::size_t size, std::size_t segment_size,
+      boost::system::error_code& ec)
+  {
+    iovec iov;
+    iov.iov_base = const_cast<char*>(data);
+    iov.iov_len = size;
+    char control[CMSG_SPACE(sizeof(std::uint16_t))];
+    std::memset(control, 0, sizeof(control));
+    msghdr h = msghdr();
+    h.msg_name = const_cast<udp::endpoint&>(destination).data();
+    h.msg_namelen = static_cast<socklen_t>(destination.size());
+    h.msg_iov = &iov;
+    h.msg_iovlen = 1;
+    h.msg_control = control;
+    h.msg_controllen = sizeof(control);
+    cmsghdr* cm = CMSG_FIRSTHDR(&h);
+    cm->cmsg_level = SOL_UDP;
+    cm->cmsg_type = UDP_SEGMENT;
+    cm->cmsg_len = CMSG_LEN(sizeof(std::uint16_t));
+    std::uint16_t gso_size = static_cast<std::uint16_t>(segment_size);
+    std::memcpy(CMSG_DATA(cm), &gso_size, sizeof(gso_size));
+    if (::sendmsg(socket.native_handle(), &h, 0) >= 0)
+      return true;
+    if (errno == EAGAIN || errno == EWOULDBLOCK)
+    {
+      ec = boost::asio::error::would_block;   //发送缓冲区满，由调用方等待可写
+      return false;
+    }
+    if (errno == EIO || errno == EINVAL || errno == ENOPROTOOPT || errno == EOPNOTSUPP)
+      return false;
+    ec = boost::system::error_code(errno, boost::asio::error::get_system_category());
+    return false;
+  }
+#endif
+
+  bool offload_;
+};
+//--------------------------------
+//GRO接收：一次收到同一发送方的多个等长数据报合并成的大包，segment(i)取出其中第i个
+//用法：等待可读 -> receive() -> for (i < segment_count()) 处理segment(i)
+class segment_receiver
+{
+public:
+  typedef boost::asio::ip::udp udp;
+
+  enum { default_buffer_size = 65536 };
+
+  explicit segment_receiver(std::size_t buffer_size = default_buffer_size)
+    : buffer_(buffer_size),
+      size_(0),
+      segment_size_(0)
+  {
+  }
+
+  //打开GRO，不支持时返回false，此后receive()每次只收一个数据报
+  static bool enable(udp::socket& socket)
+  {
+#if defined(UDP_OFFLOAD_SUPPORTED)
+    int on = 1;
+    return ::setsockopt(socket.native_handle(), SOL_UDP, UDP_GRO, &on, sizeof(on)) == 0;
+#else
+    (void)socket;
+    return false;
+#endif
+  }
+
+  //不阻塞地收一个(可能合并过的)包，没有数据时返回0、ec为would_block
+  std::size_t receive(udp::socket& socket, boost::system::error_code& ec)
+  {
+    ec = boost::system::error_code();
+    size_ = 0;
+    segment_size_ = 0;
+#if defined(UDP_OFFLOAD_SUPPORTED)
+    iovec iov;
+    iov.iov_base = buffer_.data();
+    iov.iov_len = buffer_.size();
+    char control[CMSG_SPACE(sizeof(int))];
+    msghdr h = msghdr();
+    h.msg_name = sender_.data();
+    h.msg_namelen = static_cast<socklen_t>(sender_.capacity());
+    h.msg_iov = &iov;
+    h.msg_iovlen = 1;
+    h.msg_control = control;
+    h.msg_controllen = sizeof(control);
+    ssize_t n = ::recvmsg(socket.native_handle(), &h, MSG_DONTWAIT);
+    if (n < 0)
+    {
+      ec = boost::system::error_code(errno, boost::asio::error::get_system_category());
+      if (ec == boost::asio::error::try_again)
+        ec = boost::asio::error::would_block;
+      return 0;
+    }
+    sender_.resize(h.msg_namelen);
+    size_ = static_cast<std::size_t>(n);
+    segment_size_ = size_;
+    for (cmsghdr* cm = CMSG_FIRSTHDR(&h); cm; cm = CMSG_NXTHDR(&h, cm))
+    {
+      if (cm->cmsg_level == SOL_UDP && cm->cmsg_type == UDP_GRO)
+      {
+        int gso_size = 0;
+        std::memcpy(&gso_size, CMSG_DATA(cm), sizeof(gso_size));
+        if (gso_size > 0)
+          segment_size_ = static_cast<std::size_t>(gso_size);
+      }
+    }
+#else
+    bool blocking = !socket.non_blocking();
+    socket.non_blocking(true);
+    size_ = socket.receive_from(boost::asio::buffer(buffer_), sender_, 0, ec);
+    if (blocking)
+      socket.non_blocking(false);
+    segment_size_ = size_;
+#endif
+    return size_;
+  }
+
+  const char* data() const
+  {
+    return buffer_.data();
+  }
+
+  std::size_t size() const  //合并后的总字节数
+  {
+    return size_;
+  }
+
+  std::size_t segment_size() const  //每段的大小，最后一段可能更短
+  {
+    return segment_size_;
+  }
+
+  std::size_t segment_count() const
+  {
+    return segment_size_ != 0 ? (size_ + segment_size_ - 1) / segment_size_ : 0;
+  }
+
+  boost::asio::const_buffer segment(std::size_t i) const
+  {
+    std::size_t offset = i * segment_size_;
+    std::size_t n = size_ - offset < segment_size_ ? size_ - offset : segment_size_;
+    return boost::asio::buffer(buffer_.data() + offset, n);
+  }
+
+  const udp::endpoint& sender() const
+  {
+    return sender_;
+  }
+
+private:
+  std::vector<char> buffer_;
+  std::size_t size_;
+  std::size_t segment_size_;
+  udp::endpoint sender_;
+};
+
+#endif // UDP_OFFLOAD_HPP
@@ -0,0 +1,166 @@
+//UDP分段卸载对比测试：环回上一个线程只管发，一个线程只管收，比较逐个收发和GSO/GRO的数据报速率
+//udp_offload_bench [-m <datagram_size>] [-g <segments_per_send>] [-D <seconds>] [-W <window>] [-p <port>]
+//每种方式输出一行 key=value，便于脚本解析和对比
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <thread>
+#include <vector>
+#include <boost/asio.hpp>
+#include "udp_offload.hpp"
+
+using boost::asio::ip::udp;
+//----------------------------------------------------------------------
+struct bench_options
+{
+  std::size_t datagram_size = 1200;
+  std::size_t segments = 32;
+  std::size_t seconds = 2;
+  std::size_t window = 2048;   //最多未收到的数据报数，超过时发送方让出CPU，避免接收缓冲区溢出
+  unsigned short port = 9700;
+};
+//----------------------------------------------------------------------
+struct bench_result
+{
+  std::uint64_t sent = 0;
+  std::atomic<std::uint64_t> received{0};
+  std::uint64_t receive_calls = 0;   //recvmsg次数，GRO生效时远小于received
+  std::atomic<bool> finished{false};  //接收方收到了结束标记
+  bool gso = false;
+  bool gro = false;
+  double seconds = 0;
+};
+//----------------------------------------------------------------------
+//收到长度为0的数据报为止。发送方结束时重复发空数据报作为结束标记，直到接收方确认
+void receive_all(udp::socket& socket, bool offload, bench_result& result)
+{
+  segment_receiver receiver;
+  if (offload)
+    result.gro = segment_receiver::enable(socket);
+  boost::system::error_code ec;
+  for (;;)
+  {
+    socket.wait(udp::socket::wait_read, ec);
+    if (ec)
+      return;
+    for (;;)
+    {
+      std::size_t n = receiver.receive(socket, ec);
+      if (ec == boost::asio::error::would_block)
+        break;
+      if (ec)
+        continue;
+      if (n == 0)
+      {
+        result.finished.store(true);
+        return;
+      }
+      ++result.receive_calls;
+      result.received.store(result.received.load(std::memory_order_relaxed)
+          + receiver.segment_count(), std::memory_order_release);
+    }
+  }
+}
+//----------------------------------------------------------------------
+//持续发送seconds秒。offload为false时segment_sender逐个send_to
+void send_for(udp::socket& socket, const udp::endpoint& destination,
+    const bench_options& options, bool offload, bench_result& result)
+{
+  segment_sender sender(offload);
+  std::vector<char> payload(options.datagram_size * options.segments, 'x');
+  boost::system::error_code ec;
+  auto start = std::chrono::steady_clock::now();
+  auto deadline = start + std::chrono::seconds(options.seconds);
+  while (std::chrono::steady_clock::now() < deadline)
+  {
+    while (result.sent > result.received.load(std::memory_order_acquire) + options.window)
+      std::this_thread::yield();
+    result.sent += sender.send(socket, destination, payload.data(), payload.size(),
+        options.datagram_size, ec);
+  }
+  result.seconds = std::chrono::duration<double>(
+      std::chrono::steady_clock::now() - start).count();
+  result.gso = sender.offload();
+  while (!result.finished.load())  //结束标记也可能被丢弃
+  {
+    socket.send_to(boost::asio::buffer(payload.data(), 0), destination, 0, ec);
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+}
+//----------------------------------------------------------------------
+void run_variant(const char* name, const bench_options& options, bool offload)
+{
+  boost::asio::io_context io_context;
+  udp::socket receive_socket(io_context, udp::endpoint(udp::v4(), options.port));
+  receive_socket.set_option(boost::asio::socket_base::receive_buffer_size(4 << 20));
+  udp::socket send_socket(io_context, udp::endpoint(udp::v4(), 0));
+  send_socket.set_option(boost::asio::socket_base::send_buffer_size(4 << 20));
+  udp::endpoint destination(boost::asio::ip::make_address("127.0.0.1"), options.port);
+
+  bench_result result;
+  std::thread receiver(
+      [&]()
+      {
+        receive_all(receive_socket, offload, result);
+      });
+  send_for(send_socket, destination, options, offload, result);
+  receiver.join();
+
+  double seconds = result.seconds > 0 ? result.seconds : 1;
+  std::uint64_t received = result.received.load();
+  std::cout << "variant=" << name
+    << " gso=" << result.gso
+    << " gro=" << result.gro
+    << " datagram_size=" << options.datagram_size
+    << " segments=" << options.segments
+    << " sent_pps=" << static_cast<std::uint64_t>(result.sent / seconds)
+    << " received_pps=" << static_cast<std::uint64_t>(received / seconds)
+    << " MB_per_sec=" << received * options.datagram_size / seconds / 1e6
+    << " datagrams_per_receive=" << (result.receive_calls != 0 ?
+        static_cast<double>(received) / result.receive_calls : 0.0)
+    << std::endl;
+}
+
+int main(int argc, char* argv[])
+{
+  try
+  {
+    bench_options options;
+    for (int arg = 1; arg + 1 < argc; arg += 2)
+    {
+      if (std::strcmp(argv[arg], "-m") == 0)  //每个数据报的字节数
+        options.datagram_size = std::strtoul(argv[arg + 1], nullptr, 10);
+      else if (std::strcmp(argv[arg], "-g") == 0)  //每次发送的数据报数
+        options.segments = std::strtoul(argv[arg + 1], nullptr, 10);
+      else if (std::strcmp(argv[arg], "-D") == 0)  //每种方式测试的秒数
+        options.seconds = std::strtoul(argv[arg + 1], nullptr, 10);
+      else if (std::strcmp(argv[arg], "-W") == 0)  //未收到的数据报上限
+        options.window = std::strtoul(argv[arg + 1], nullptr, 10);
+      else if (std::strcmp(argv[arg], "-p") == 0)
+        options.port = static_cast<unsigned short>(std::atoi(argv[arg + 1]));
+      else
+      {
+        std::cerr << "Usage: udp_offload_bench [-m <datagram_size>] [-g <segments_per_send>]"
+          " [-D <seconds>] [-W <window>] [-p <port>]\n";
+        return 1;
+      }
+    }
+    if (options.datagram_size == 0 || options.segments == 0)
+    {
+      std::cerr << "datagram size and segments must be positive\n";
+      return 1;
+    }
+
+    run_variant("per_datagram", options, false);
+    run_variant("gso_gro", options, true);
+  }
+  catch (std::exception& e)
+  {
+    std::cerr << "Exception: " << e.what() << "\n";
+  }
+
+  return 0;
+}